@@ -0,0 +1,296 @@
+#include "AllocStats.h"
+
+#ifdef PARTICLES_ALLOC_STATS
+#include <atomic>
+#include <cstdlib> // For malloc, aligned_alloc, free
+#include <new>
+#endif
+
+using namespace AllocStats;
+
+namespace
+{
+    const char* const NAMES[SUBSYSTEM_COUNT + 1] = {
+        "other", "matrices", "particle", "simulation", "render", "engine", "total"
+    };
+}
+
+const char* AllocStats::name(Subsystem subsystem)
+{
+    return NAMES[subsystem <= SUBSYSTEM_COUNT ? subsystem : SUBSYSTEM_COUNT];
+}
+
+#ifdef PARTICLES_ALLOC_STATS
+
+namespace
+{
+    ///Every counter of one subsystem, on a cache line of its own so threads
+    ///allocating for different subsystems do not share one
+    struct alignas(64) Tally
+    {
+        atomic<uint64_t> allocations;
+        atomic<uint64_t> frees;
+        atomic<uint64_t> bytes;
+        atomic<int64_t> live;
+        atomic<int64_t> peak;
+        atomic<int64_t> framePeak;
+    };
+
+    ///In front of every block: what it cost and whom, and how far in front
+    ///of the allocation it starts (16, or the alignment asked for)
+    struct BlockHeader
+    {
+        uint64_t size;
+        uint32_t subsystem;
+        uint32_t offset;
+    };
+    static_assert(sizeof(BlockHeader) == 16, "the header keeps new's 16 byte alignment");
+
+    ///One frame's figures per subsystem, the last slot for the total
+    struct FrameRecord
+    {
+        uint32_t frame;
+        uint64_t particles;
+        Counters counters[SUBSYSTEM_COUNT + 1];
+    };
+
+    ///frames kept for dumpCsv, the profiler's history length
+    const unsigned HISTORY_FRAMES = 600;
+
+    //constant-initialized, so counting works from the first allocation,
+    //before any constructor has run; the last tally is the total
+    Tally g_tally[SUBSYSTEM_COUNT + 1];
+    thread_local Subsystem t_current = OTHER;
+
+    //frame thread only; fixed arrays, so closing a frame allocates nothing
+    Counters g_lastTotals[SUBSYSTEM_COUNT + 1];
+    FrameRecord g_history[HISTORY_FRAMES];
+    uint32_t g_frames = 0;
+
+    void raiseTo(atomic<int64_t>& peak, int64_t value)
+    {
+        int64_t seen = peak.load(memory_order_relaxed);
+        while (value > seen && !peak.compare_exchange_weak(seen, value, memory_order_relaxed)) {
+        }
+    }
+
+    void count(Tally& tally, uint64_t size)
+    {
+        tally.allocations.fetch_add(1, memory_order_relaxed);
+        tally.bytes.fetch_add(size, memory_order_relaxed);
+        const int64_t live = tally.live.fetch_add((int64_t)size, memory_order_relaxed) + (int64_t)size;
+        raiseTo(tally.peak, live);
+        raiseTo(tally.framePeak, live);
+    }
+
+    void uncount(Tally& tally, uint64_t size)
+    {
+        tally.frees.fetch_add(1, memory_order_relaxed);
+        tally.live.fetch_sub((int64_t)size, memory_order_relaxed);
+    }
+
+    void* allocate(size_t size, size_t alignment)
+    {
+        const size_t offset = alignment > sizeof(BlockHeader) ? alignment : sizeof(BlockHeader);
+        uint8_t* base;
+        if (alignment > sizeof(BlockHeader)) {
+            // aligned_alloc wants a multiple of the alignment
+            base = static_cast<uint8_t*>(aligned_alloc(alignment, (size + offset + alignment - 1) / alignment * alignment));
+        }
+        else {
+            base = static_cast<uint8_t*>(malloc(size + offset));
+        }
+        if (base == nullptr) {
+            return nullptr;
+        }
+        uint8_t* block = base + offset;
+        BlockHeader* header = reinterpret_cast<BlockHeader*>(block) - 1;
+        header->size = size;
+        header->subsystem = t_current;
+        header->offset = (uint32_t)offset;
+        count(g_tally[t_current], size);
+        count(g_tally[SUBSYSTEM_COUNT], size);
+        return block;
+    }
+
+    void* allocateOrThrow(size_t size, size_t alignment)
+    {
+        for (;;) {
+            void* block = allocate(size, alignment);
+            if (block != nullptr) {
+                return block;
+            }
+            new_handler handler = get_new_handler();
+            if (handler == nullptr) {
+                throw bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    void deallocate(void* block)
+    {
+        if (block == nullptr) {
+            return;
+        }
+        const BlockHeader* header = static_cast<const BlockHeader*>(block) - 1;
+        uncount(g_tally[header->subsystem], header->size);
+        uncount(g_tally[SUBSYSTEM_COUNT], header->size);
+        free(static_cast<uint8_t*>(block) - header->offset);
+    }
+
+    Counters read(const Tally& tally)
+    {
+        return { tally.allocations.load(memory_order_relaxed), tally.frees.load(memory_order_relaxed),
+                 tally.bytes.load(memory_order_relaxed), tally.live.load(memory_order_relaxed),
+                 tally.peak.load(memory_order_relaxed) };
+    }
+
+    const FrameRecord* lastRecord()
+    {
+        return g_frames == 0 ? nullptr : &g_history[(g_frames - 1) % HISTORY_FRAMES];
+    }
+
+    ///Prints the table once main has returned
+    struct ExitReport
+    {
+        ~ExitReport() { report(stderr); }
+    } g_exitReport;
+}
+
+Counters AllocStats::total(Subsystem subsystem)
+{
+    return read(g_tally[subsystem <= SUBSYSTEM_COUNT ? subsystem : SUBSYSTEM_COUNT]);
+}
+
+Counters AllocStats::lastFrame(Subsystem subsystem)
+{
+    const FrameRecord* record = lastRecord();
+    return record == nullptr ? Counters() : record->counters[subsystem <= SUBSYSTEM_COUNT ? subsystem : SUBSYSTEM_COUNT];
+}
+
+double AllocStats::bytesPerParticle()
+{
+    const FrameRecord* record = lastRecord();
+    if (record == nullptr || record->particles == 0) {
+        return 0.0;
+    }
+    return (double)record->counters[SUBSYSTEM_COUNT].liveBytes / record->particles;
+}
+
+void AllocStats::endFrame(size_t liveParticles)
+{
+    FrameRecord& record = g_history[g_frames % HISTORY_FRAMES];
+    record.frame = g_frames++;
+    record.particles = liveParticles;
+    for (int s = 0; s <= SUBSYSTEM_COUNT; ++s) {
+        const Counters now = read(g_tally[s]);
+        Counters& frame = record.counters[s];
+        frame.allocations = now.allocations - g_lastTotals[s].allocations;
+        frame.frees = now.frees - g_lastTotals[s].frees;
+        frame.bytes = now.bytes - g_lastTotals[s].bytes;
+        frame.liveBytes = now.liveBytes;
+        // The next frame's peak starts from what is live now
+        frame.peakBytes = g_tally[s].framePeak.exchange(now.liveBytes, memory_order_relaxed);
+        g_lastTotals[s] = now;
+    }
+}
+
+bool AllocStats::dumpCsv(const string& path)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "frame,subsystem,allocations,frees,bytes,live_bytes,peak_bytes,particles\n");
+    const uint32_t first = g_frames > HISTORY_FRAMES ? g_frames - HISTORY_FRAMES : 0;
+    for (uint32_t f = first; f < g_frames; ++f) {
+        const FrameRecord& record = g_history[f % HISTORY_FRAMES];
+        for (int s = 0; s <= SUBSYSTEM_COUNT; ++s) {
+            const Counters& c = record.counters[s];
+            fprintf(file, "%u,%s,%llu,%llu,%llu,%lld,%lld,%llu\n", record.frame, NAMES[s],
+                    (unsigned long long)c.allocations, (unsigned long long)c.frees, (unsigned long long)c.bytes,
+                    (long long)c.liveBytes, (long long)c.peakBytes, (unsigned long long)record.particles);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+void AllocStats::report(FILE* out)
+{
+    fprintf(out, "\nHeap by subsystem (since start; last frame in the last two columns)\n");
+    fprintf(out, "%-12s %14s %14s %16s %14s %14s %12s %14s\n", "subsystem", "allocations", "frees", "bytes",
+            "live bytes", "peak bytes", "frame allocs", "frame bytes");
+    const FrameRecord* record = lastRecord();
+    for (int s = 0; s <= SUBSYSTEM_COUNT; ++s) {
+        const Counters c = read(g_tally[s]);
+        const Counters frame = record != nullptr ? record->counters[s] : Counters();
+        fprintf(out, "%-12s %14llu %14llu %16llu %14lld %14lld %12llu %14llu\n", NAMES[s],
+                (unsigned long long)c.allocations, (unsigned long long)c.frees, (unsigned long long)c.bytes,
+                (long long)c.liveBytes, (long long)c.peakBytes,
+                (unsigned long long)frame.allocations, (unsigned long long)frame.bytes);
+    }
+    if (record != nullptr && record->particles > 0) {
+        fprintf(out, "%.1f live bytes per particle (%llu particles, frame %u)\n", bytesPerParticle(),
+                (unsigned long long)record->particles, record->frame);
+    }
+}
+
+Subsystem AllocStats::current()
+{
+    return t_current;
+}
+
+AllocStats::Scope::Scope(Subsystem subsystem)
+    : m_previous(t_current)
+{
+    t_current = subsystem;
+}
+
+AllocStats::Scope::~Scope()
+{
+    t_current = m_previous;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// The replaced global operators
+
+void* operator new(size_t size) { return allocateOrThrow(size, 0); }
+void* operator new[](size_t size) { return allocateOrThrow(size, 0); }
+void* operator new(size_t size, align_val_t alignment) { return allocateOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, align_val_t alignment) { return allocateOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocate(size, (size_t)alignment); }
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocate(size, (size_t)alignment); }
+
+// The header knows the size and where the block starts, so every delete is the same
+void operator delete(void* block) noexcept { deallocate(block); }
+void operator delete[](void* block) noexcept { deallocate(block); }
+void operator delete(void* block, size_t) noexcept { deallocate(block); }
+void operator delete[](void* block, size_t) noexcept { deallocate(block); }
+void operator delete(void* block, align_val_t) noexcept { deallocate(block); }
+void operator delete[](void* block, align_val_t) noexcept { deallocate(block); }
+void operator delete(void* block, size_t, align_val_t) noexcept { deallocate(block); }
+void operator delete[](void* block, size_t, align_val_t) noexcept { deallocate(block); }
+void operator delete(void* block, const nothrow_t&) noexcept { deallocate(block); }
+void operator delete[](void* block, const nothrow_t&) noexcept { deallocate(block); }
+void operator delete(void* block, align_val_t, const nothrow_t&) noexcept { deallocate(block); }
+void operator delete[](void* block, align_val_t, const nothrow_t&) noexcept { deallocate(block); }
+
+#else
+
+// Compiled out: nothing is counted
+
+Counters AllocStats::total(Subsystem) { return Counters(); }
+Counters AllocStats::lastFrame(Subsystem) { return Counters(); }
+double AllocStats::bytesPerParticle() { return 0.0; }
+void AllocStats::endFrame(size_t) {}
+bool AllocStats::dumpCsv(const string&) { return false; }
+void AllocStats::report(FILE* out) { fprintf(out, "Allocation stats are not built in (make ALLOC_STATS=1)\n"); }
+Subsystem AllocStats::current() { return OTHER; }
+AllocStats::Scope::Scope(Subsystem subsystem) : m_previous(subsystem) {}
+AllocStats::Scope::~Scope() {}
+
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+///Heap instrumentation: how often, how much and for what the program allocates.
+///
+///Built with -DPARTICLES_ALLOC_STATS (make ALLOC_STATS=1), this file replaces
+///the global operator new / delete.  Every block carries a small header with
+///its size and the subsystem that asked for it, so each subsystem's
+///allocations, frees, bytes, live bytes and peak are counted exactly, from
+///any thread.  ALLOC_SCOPE(AllocStats::MATRICES) charges the rest of the
+///block to a subsystem on the calling thread; the innermost scope wins, and
+///ThreadPool workers take the scope of the thread that started the job.
+///
+///endFrame closes a frame: the per-frame figures (allocations, bytes, peak
+///live during the frame, bytes per live particle) go on the HUD and into the
+///history dumpCsv writes with the profiler's F5 dump, and a table of the
+///counters is printed to stderr at exit.
+///
+///Without the flag nothing is replaced, ALLOC_SCOPE compiles away and the
+///functions below report zeros: new and delete are the library's own.
+namespace AllocStats
+{
+#ifdef PARTICLES_ALLOC_STATS
+    const bool ENABLED = true;
+#else
+    const bool ENABLED = false;
+#endif
+
+    enum Subsystem : uint8_t
+    {
+        OTHER,          //anything outside a scope (startup, SFML, the standard library)
+        MATRICES,       //Matrix storage and the transform temporaries
+        PARTICLE,       //Particle and ParticleSystem
+        SIMULATION,     //the tick: input queue, backlog, emitters
+        RENDER,         //snapshots, vertex buffers, the rasterizer
+        ENGINE,         //window loop, input, HUD
+        SUBSYSTEM_COUNT
+    };
+
+    const char* name(Subsystem subsystem);
+
+    struct Counters
+    {
+        uint64_t allocations;
+        uint64_t frees;
+        uint64_t bytes;         //allocated
+        int64_t liveBytes;
+        int64_t peakBytes;
+    };
+
+    ///Since the start; subsystem SUBSYSTEM_COUNT is every subsystem together
+    Counters total(Subsystem subsystem = SUBSYSTEM_COUNT);
+
+    ///The last frame: allocations, frees and bytes during it, live bytes at
+    ///its end and the peak live bytes within it
+    Counters lastFrame(Subsystem subsystem = SUBSYSTEM_COUNT);
+    ///Live heap bytes per live particle at the end of the last frame
+    double bytesPerParticle();
+
+    ///Close a frame with liveParticles particles alive; call from the frame
+    ///thread, once a frame
+    void endFrame(size_t liveParticles);
+
+    ///Write the last frames' figures as CSV:
+    ///frame,subsystem,allocations,frees,bytes,live_bytes,peak_bytes,particles
+    bool dumpCsv(const string& path);
+
+    ///Print the counters as a table
+    void report(FILE* out);
+
+    ///Subsystem new allocations are charged to on the calling thread
+    Subsystem current();
+
+    ///Charges the calling thread's allocations to a subsystem for its lifetime;
+    ///use through ALLOC_SCOPE
+    class Scope
+    {
+    public:
+        explicit Scope(Subsystem subsystem);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Subsystem m_previous;
+    };
+}
+
+#define ALLOC_STATS_CONCAT_INNER(a, b) a##b
+#define ALLOC_STATS_CONCAT(a, b) ALLOC_STATS_CONCAT_INNER(a, b)
+
+#ifdef PARTICLES_ALLOC_STATS
+#define ALLOC_SCOPE(subsystem) AllocStats::Scope ALLOC_STATS_CONCAT(allocScope, __LINE__)(subsystem)
+#else
+#define ALLOC_SCOPE(subsystem) ((void)0)
+#endif
@@ -0,0 +1,313 @@
+#include "Benchmark.h"
+#include "AllocStats.h"
+#include "Engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace
+{
+    typedef chrono::steady_clock BenchClock;
+
+    double elapsedNs(BenchClock::time_point from, BenchClock::time_point to)
+    {
+        return (double)chrono::duration_cast<chrono::nanoseconds>(to - from).count();
+    }
+
+    template <typename T>
+    vector<T> parseList(const char* text)
+    {
+        vector<T> values;
+        stringstream in(text);
+        string item;
+        while (getline(in, item, ',')) {
+            if (!item.empty()) {
+                values.push_back((T)strtoull(item.c_str(), nullptr, 10));
+            }
+        }
+        return values;
+    }
+
+    double percentile(vector<double> samples, double p)
+    {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        size_t index = (size_t)(p * (samples.size() - 1) + 0.5);
+        nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+}
+
+bool Benchmark::parseArgs(int argc, char* argv[], BenchmarkConfig& config)
+{
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--headless") == 0) {
+            headless = true;
+            continue;
+        }
+        if (strcmp(arg, "--collisions") == 0) {
+            config.collisions = true;
+            continue;
+        }
+        if (strcmp(arg, "--raster") == 0) {
+            config.raster = true;
+            continue;
+        }
+        if (value == nullptr) {
+            continue;
+        }
+        if (strcmp(arg, "--threads") == 0) config.threadCounts = parseList<unsigned>(value);
+        else if (strcmp(arg, "--particles") == 0) config.particleCounts = parseList<size_t>(value);
+        else if (strcmp(arg, "--per-click") == 0) config.particlesPerClick = max(1, atoi(value));
+        else if (strcmp(arg, "--clicks") == 0) config.clicksPerSecond = (float)atof(value);
+        else if (strcmp(arg, "--duration") == 0) config.duration = (float)atof(value);
+        else if (strcmp(arg, "--warmup") == 0) config.warmup = (float)atof(value);
+        else if (strcmp(arg, "--seed") == 0) config.seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--csv") == 0) config.csvPath = value;
+        else if (strcmp(arg, "--restore") == 0) config.restorePath = value;
+        else if (strcmp(arg, "--frame-budget") == 0) config.frameBudgetMs = atof(value);
+        else if (strcmp(arg, "--max-particles") == 0) config.maxParticles = (size_t)strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--save-checkpoint") == 0) config.savePath = value;
+        else if (strcmp(arg, "--frame-out") == 0) config.framePath = value;
+        else if (strcmp(arg, "--viewport") == 0) {
+            unsigned w = 0, h = 0;
+            if (sscanf(value, "%ux%u", &w, &h) == 2 && w > 0 && h > 0) {
+                config.viewport = Vector2u(w, h);
+            }
+        }
+        else continue;
+        ++i;
+    }
+    return headless;
+}
+
+vector<BenchmarkResult> Benchmark::run()
+{
+    vector<unsigned> threadCounts = m_config.threadCounts;
+    if (threadCounts.empty()) {
+        threadCounts.push_back(0);
+    }
+
+    // Each particle count is turned into the click rate measured to hold it
+    vector<size_t> targets = m_config.particleCounts;
+    vector<float> clickRates;
+    for (size_t count : targets) {
+        clickRates.push_back(calibrate(count));
+    }
+    if (clickRates.empty()) {
+        targets.push_back(0);
+        clickRates.push_back(m_config.clicksPerSecond);
+    }
+
+    printf("%8s %10s %10s %8s %12s %14s %10s %10s %10s %10s %10s %10s\n", "threads", "target", "clicks/s", "frames",
+           "particles", "particles/s", "ns/part", "p50 ms", "p99 ms", "update ms", "draw ms", "raster ms");
+
+    vector<BenchmarkResult> results;
+    for (size_t i = 0; i < clickRates.size(); ++i) {
+        for (unsigned threads : threadCounts) {
+            BenchmarkResult r = runOne(threads, clickRates[i]);
+            r.targetParticles = targets[i];
+            printf("%8u %10zu %10.1f %8zu %12.0f %14.0f %10.2f %10.3f %10.3f %10.3f %10.3f %10.3f\n", r.threads,
+                   r.targetParticles, r.clicksPerSecond, r.frames, r.avgParticles, r.particlesPerSec, r.nsPerParticle,
+                   r.frameP50Ms, r.frameP99Ms, r.updateAvgMs, r.drawAvgMs, r.rasterAvgMs);
+            if (AllocStats::ENABLED) {
+                printf("%8s heap: %.1f allocations, %.0f bytes a frame, %.0f live bytes per particle\n", "",
+                       r.allocsPerFrame, r.allocBytesPerFrame, r.bytesPerParticle);
+            }
+            results.push_back(r);
+        }
+    }
+
+    writeCsv(results);
+    return results;
+}
+
+float Benchmark::calibrate(size_t particles)
+{
+    // Live particles = particles spawned a second * how long they live on
+    // average.  Culling retires most of them well before TTL, so TTL only
+    // gives the first guess; each pass then scales the rate by how far the
+    // measured count is off.  Without collisions or a cap the live count is
+    // proportional to the rate and one correction is enough.
+    float rate = (float)particles / (m_config.particlesPerClick * TTL);
+    double live = 0.0;
+    for (int pass = 0; pass < 4 && particles > 0; ++pass) {
+        live = measureLive(rate);
+        if (live <= 0.0) {
+            break;
+        }
+        const double error = (double)particles / live;
+        rate = (float)(rate * error);
+        if (error > 0.98 && error < 1.02) {
+            break;
+        }
+    }
+    printf("Calibrated %zu particles: %.1f clicks/s (last pass held %.0f)\n", particles, rate, live);
+    return rate;
+}
+
+double Benchmark::measureLive(float clicksPerSecond)
+{
+    // Same frames as runOne but only the simulation: nothing is drawn
+    Engine engine(m_config.viewport, 0, m_config.seed);
+    setUp(engine);
+    Rng clicks(m_config.seed, 1);
+    const float dt = m_config.dt;
+    const size_t warmupFrames = (size_t)(m_config.warmup / dt + 0.5f);
+    const size_t measuredFrames = max<size_t>(1, (size_t)(m_config.duration / dt + 0.5f));
+
+    double liveSum = 0.0;
+    double clickDebt = 0.0;
+    for (size_t frame = 0; frame < warmupFrames + measuredFrames; ++frame) {
+        click(engine, clicks, clickDebt, clicksPerSecond);
+        engine.step(dt);
+        if (frame >= warmupFrames) {
+            liveSum += (double)engine.getParticleCount();
+        }
+    }
+    return liveSum / measuredFrames;
+}
+
+void Benchmark::setUp(Engine& engine) const
+{
+    engine.setCollisions(m_config.collisions);
+    engine.setFrameBudget(m_config.frameBudgetMs);
+    engine.setMaxParticles(m_config.maxParticles);
+    // A checkpoint warm-starts the run at a known load instead of from empty
+    if (!m_config.restorePath.empty() && !engine.loadCheckpoint(m_config.restorePath)) {
+        cerr << "Starting from no particles instead" << endl;
+    }
+}
+
+void Benchmark::click(Engine& engine, Rng& clicks, double& clickDebt, float clicksPerSecond) const
+{
+    // Scripted input: M clicks per second spread evenly over the frames
+    const Vector2u size = m_config.viewport;
+    clickDebt += clicksPerSecond * m_config.dt;
+    while (clickDebt >= 1.0) {
+        clickDebt -= 1.0;
+        engine.spawnClick(Vector2i(clicks.range(0, size.x - 1), clicks.range(0, size.y - 1)), m_config.particlesPerClick);
+    }
+}
+
+BenchmarkResult Benchmark::runOne(unsigned threads, float clicksPerSecond)
+{
+    // Same seed for every run so each configuration sees the same particles
+    Engine engine(m_config.viewport, threads, m_config.seed);
+    setUp(engine);
+    Rng clicks(m_config.seed, 1);
+    const float dt = m_config.dt;
+    const size_t warmupFrames = (size_t)(m_config.warmup / dt + 0.5f);
+    const size_t measuredFrames = max<size_t>(1, (size_t)(m_config.duration / dt + 0.5f));
+
+    vector<double> frameMs;
+    frameMs.reserve(measuredFrames);
+    double updateNs = 0.0;
+    double drawNs = 0.0;
+    double rasterNs = 0.0;
+    double allocations = 0.0;
+    double allocBytes = 0.0;
+    double particleUpdates = 0.0;
+    double clickDebt = 0.0;
+
+    for (size_t frame = 0; frame < warmupFrames + measuredFrames; ++frame) {
+        BenchClock::time_point start = BenchClock::now();
+
+        click(engine, clicks, clickDebt, clicksPerSecond);
+
+        BenchClock::time_point updateStart = BenchClock::now();
+        engine.step(dt);
+        BenchClock::time_point updateEnd = BenchClock::now();
+        engine.buildFrame();
+        BenchClock::time_point drawEnd = BenchClock::now();
+        if (m_config.raster) {
+            engine.rasterizeFrame();
+        }
+        BenchClock::time_point end = BenchClock::now();
+        AllocStats::endFrame(engine.getParticleCount());
+
+        if (frame >= warmupFrames) {
+            updateNs += elapsedNs(updateStart, updateEnd);
+            drawNs += elapsedNs(updateEnd, drawEnd);
+            rasterNs += elapsedNs(drawEnd, end);
+            allocations += (double)AllocStats::lastFrame().allocations;
+            allocBytes += (double)AllocStats::lastFrame().bytes;
+            particleUpdates += (double)engine.getParticleCount();
+            frameMs.push_back(elapsedNs(start, end) / 1e6);
+        }
+    }
+
+    if (!m_config.savePath.empty()) {
+        engine.saveCheckpoint(m_config.savePath);
+    }
+    // Each run overwrites the last one's frame
+    if (!m_config.framePath.empty()) {
+        engine.saveFrame(m_config.framePath);
+    }
+
+    double totalFrameMs = 0.0;
+    for (double ms : frameMs) {
+        totalFrameMs += ms;
+    }
+
+    BenchmarkResult r;
+    r.threads = engine.getThreadCount();
+    r.targetParticles = 0;
+    r.clicksPerSecond = clicksPerSecond;
+    r.frames = frameMs.size();
+    r.avgParticles = particleUpdates / r.frames;
+    r.particlesPerSec = totalFrameMs > 0.0 ? particleUpdates / (totalFrameMs / 1e3) : 0.0;
+    r.nsPerParticle = particleUpdates > 0.0 ? updateNs / particleUpdates : 0.0;
+    r.frameP50Ms = percentile(frameMs, 0.50);
+    r.frameP99Ms = percentile(frameMs, 0.99);
+    r.updateAvgMs = updateNs / 1e6 / r.frames;
+    r.drawAvgMs = drawNs / 1e6 / r.frames;
+    r.rasterAvgMs = rasterNs / 1e6 / r.frames;
+    r.allocsPerFrame = allocations / r.frames;
+    r.allocBytesPerFrame = allocBytes / r.frames;
+    r.bytesPerParticle = AllocStats::bytesPerParticle();
+    return r;
+}
+
+void Benchmark::writeCsv(const vector<BenchmarkResult>& results) const
+{
+    if (m_config.csvPath.empty()) {
+        return;
+    }
+
+    ofstream out(m_config.csvPath);
+    if (!out) {
+        cerr << "Could not write " << m_config.csvPath << endl;
+        return;
+    }
+
+    out << "threads,per_click,target_particles,clicks_per_sec,frames,avg_particles,particles_per_sec,"
+           "ns_per_particle,frame_p50_ms,frame_p99_ms,update_avg_ms,draw_avg_ms,raster_avg_ms,"
+           "allocs_per_frame,alloc_bytes_per_frame,bytes_per_particle\n";
+    for (const BenchmarkResult& r : results) {
+        out << r.threads << ',' << m_config.particlesPerClick << ',' << r.targetParticles << ',' << r.clicksPerSecond << ','
+            << r.frames << ',' << r.avgParticles << ',' << r.particlesPerSec << ','
+            << r.nsPerParticle << ',' << r.frameP50Ms << ',' << r.frameP99Ms << ','
+            << r.updateAvgMs << ',' << r.drawAvgMs << ',' << r.rasterAvgMs << ',';
+        // Left empty when the counters are not built in, rather than a misleading 0
+        if (AllocStats::ENABLED) {
+            out << r.allocsPerFrame << ',' << r.allocBytesPerFrame << ',' << r.bytesPerParticle;
+        }
+        else {
+            out << ",,";
+        }
+        out << '\n';
+    }
+    cout << "Wrote " << results.size() << " rows to " << m_config.csvPath << endl;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Engine;
+class Rng;
+
+using namespace sf;
+using namespace std;
+
+///Settings for a headless benchmark run (see Benchmark::parseArgs for the flags)
+struct BenchmarkConfig
+{
+    Vector2u viewport = Vector2u(1920, 1080);
+    float dt = 1.0f / 60.0f;        //fixed simulation step
+    float warmup = 5.0f;            //seconds simulated before measuring (one TTL reaches steady state)
+    float duration = 5.0f;          //seconds simulated while measuring
+    int particlesPerClick = 5;      //N
+    float clicksPerSecond = 20.0f;  //M, used when particleCounts is empty
+    vector<size_t> particleCounts;  //average live counts to sweep (click rates are calibrated to them)
+    vector<unsigned> threadCounts;  //thread counts to sweep (0 = one per core)
+    unsigned seed = 1;
+    bool collisions = false;        //particle-particle collisions on
+    bool raster = false;            //rasterize every frame on the CPU, timed on its own
+    double frameBudgetMs = 0.0;     //governor target (0 = off: full detail, no cap)
+    size_t maxParticles = 0;        //hard particle cap (0 = none)
+    string restorePath;             //checkpoint every run starts from, if set
+    string savePath;                //checkpoint written at the end of every run, if set
+    string framePath;               //last frame of every run, as PNG or PPM, if set
+    string csvPath = "bench_results.csv";
+};
+
+///Measurements of one (thread count, spawn rate) run
+struct BenchmarkResult
+{
+    unsigned threads;
+    size_t targetParticles;    //live count the click rate was calibrated to (0 = fixed --clicks)
+    float clicksPerSecond;
+    size_t frames;
+    double avgParticles;
+    double particlesPerSec;    //particle updates per second of frame time
+    double nsPerParticle;      //update phase only
+    double frameP50Ms;
+    double frameP99Ms;
+    double updateAvgMs;
+    double drawAvgMs;          //vertex buffer build, no presentation
+    double rasterAvgMs;        //CPU rasterization of the vertex buffer (0 without --raster)
+    //heap traffic, in an ALLOC_STATS build only
+    double allocsPerFrame;
+    double allocBytesPerFrame;
+    double bytesPerParticle;   //live heap bytes per live particle at the end
+};
+
+///Runs the Engine headless with a fixed dt and a scripted spawn pattern:
+///N particles per click, M clicks per second at pseudo-random positions.
+///Sweeps thread counts x particle counts and writes one CSV row per run.
+///Particles fall out of view long before their TTL, so each particle count
+///gets its click rate from short simulation-only runs, not from the TTL.
+class Benchmark
+{
+public:
+    explicit Benchmark(const BenchmarkConfig& config) : m_config(config) {}
+
+    ///Fill config from the command line.  Returns false if --headless is absent.
+    ///  --headless [--threads 1,2,4] [--particles 10000,50000] [--per-click N]
+    ///  [--clicks M] [--duration s] [--warmup s] [--viewport WxH] [--seed n] [--csv path]
+    ///  [--collisions] [--restore checkpoint] [--save-checkpoint path]
+    ///  [--frame-budget ms] [--max-particles n] [--raster] [--frame-out image]
+    static bool parseArgs(int argc, char* argv[], BenchmarkConfig& config);
+
+    ///Run every combination, print a table and write the CSV
+    vector<BenchmarkResult> run();
+
+private:
+    BenchmarkConfig m_config;
+
+    BenchmarkResult runOne(unsigned threads, float clicksPerSecond);
+    float calibrate(size_t particles);
+    double measureLive(float clicksPerSecond);
+    void setUp(Engine& engine) const;
+    void click(Engine& engine, Rng& clicks, double& clickDebt, float clicksPerSecond) const;
+    void writeCsv(const vector<BenchmarkResult>& results) const;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+
+using namespace sf;
+
+///The Cartesian plane every particle lives in: origin at the center of the
+///window, y axis pointing up, one unit per pixel.
+///Replaces the per-particle sf::View.  The pixel mapping is a plain 2D affine
+///(px = x + W/2, py = H/2 - y) that is only recomputed when the size changes.
+class CartesianView
+{
+public:
+    explicit CartesianView(Vector2u pixelSize = Vector2u(0, 0)) { setSize(pixelSize); }
+
+    ///Call on startup and whenever the window is resized
+    void setSize(Vector2u pixelSize)
+    {
+        m_size = pixelSize;
+        m_halfWidth = pixelSize.x / 2.0f;
+        m_halfHeight = pixelSize.y / 2.0f;
+        m_toPixel = Transform(1.0f, 0.0f, m_halfWidth,
+                              0.0f, -1.0f, m_halfHeight,
+                              0.0f, 0.0f, 1.0f);
+    }
+
+    Vector2u getSize() const { return m_size; }
+
+    ///The visible part of the plane in Cartesian coordinates.  y points up, so
+    ///the rect's top is the lowest visible y.
+    FloatRect getBounds() const
+    {
+        return FloatRect(-m_halfWidth, -m_halfHeight, (float)m_size.x, (float)m_size.y);
+    }
+
+    ///Window pixel -> Cartesian coordinates
+    Vector2f pixelToCoords(Vector2i pixel) const
+    {
+        return Vector2f(pixel.x - m_halfWidth, m_halfHeight - pixel.y);
+    }
+
+    ///Cartesian coordinates -> window pixel
+    Vector2f coordsToPixel(double x, double y) const
+    {
+        return Vector2f((float)(x + m_halfWidth), (float)(m_halfHeight - y));
+    }
+
+    ///The same mapping as an sf::Transform, for RenderStates
+    const Transform& getTransform() const { return m_toPixel; }
+
+private:
+    Vector2u m_size;
+    float m_halfWidth;
+    float m_halfHeight;
+    Transform m_toPixel;
+};
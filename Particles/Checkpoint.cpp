@@ -0,0 +1,210 @@
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cstring> // For memcmp, memcpy
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHECKPOINT_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    ///Section payloads are written this much at a time
+    const size_t WRITE_BLOCK = 1 << 20;
+
+    struct SectionHeader
+    {
+        char tag[4];
+        uint32_t elementSize;
+        uint64_t count;
+    };
+
+    size_t alignUp(size_t offset)
+    {
+        return (offset + Checkpoint::ALIGNMENT - 1) & ~(Checkpoint::ALIGNMENT - 1);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Writer
+
+Checkpoint::Writer::~Writer()
+{
+    if (m_file != nullptr) {
+        fclose(m_file);
+    }
+}
+
+bool Checkpoint::Writer::open(const string& path, const Header& header)
+{
+    m_file = fopen(path.c_str(), "wb");
+    if (m_file == nullptr) {
+        return false;
+    }
+    m_header = header;
+    memcpy(m_header.magic, MAGIC, 4);
+    m_header.version = VERSION;
+    m_header.byteOrder = ENDIAN_MARK;
+    m_header.sections = 0;
+    m_offset = 0;
+    m_failed = false;
+    write(&m_header, sizeof(m_header));
+    return true;
+}
+
+void Checkpoint::Writer::section(const char tag[4], const void* data, size_t elementSize, size_t count)
+{
+    pad();
+    SectionHeader section;
+    memcpy(section.tag, tag, 4);
+    section.elementSize = (uint32_t)elementSize;
+    section.count = count;
+    write(&section, sizeof(section));
+    pad();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t left = elementSize * count;
+    while (left > 0) {
+        const size_t block = min(left, WRITE_BLOCK);
+        write(bytes, block);
+        bytes += block;
+        left -= block;
+    }
+    ++m_header.sections;
+}
+
+bool Checkpoint::Writer::finish()
+{
+    if (m_file == nullptr) {
+        return false;
+    }
+    // The header went out first with no sections; rewrite it now that they are known
+    if (fseek(m_file, 0, SEEK_SET) != 0) {
+        m_failed = true;
+    }
+    write(&m_header, sizeof(m_header));
+    m_failed = fclose(m_file) != 0 || m_failed;
+    m_file = nullptr;
+    return !m_failed;
+}
+
+void Checkpoint::Writer::write(const void* data, size_t bytes)
+{
+    if (fwrite(data, 1, bytes, m_file) != bytes) {
+        m_failed = true;
+    }
+    m_offset += bytes;
+}
+
+void Checkpoint::Writer::pad()
+{
+    static const uint8_t zeros[ALIGNMENT] = {};
+    write(zeros, alignUp(m_offset) - m_offset);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// MappedFile
+
+bool Checkpoint::MappedFile::open(const string& path, string& error)
+{
+    close();
+
+#ifdef CHECKPOINT_MMAP
+    // MAP_PRIVATE: pages come straight from the page cache and are only
+    // faulted in as the restore copies them
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        error = path + " is empty";
+        return false;
+    }
+    void* map = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(map);
+    m_size = (size_t)info.st_size;
+    m_mapped = true;
+#else
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+    uint8_t block[4096];
+    size_t got;
+    while ((got = fread(block, 1, sizeof(block), file)) > 0) {
+        m_buffer.insert(m_buffer.end(), block, block + got);
+    }
+    fclose(file);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+
+    if (m_size < sizeof(Header) || memcmp(header().magic, MAGIC, 4) != 0) {
+        error = path + " is not a checkpoint";
+        close();
+        return false;
+    }
+    if (header().byteOrder != ENDIAN_MARK) {
+        error = path + " was written on a machine with a different byte order";
+        close();
+        return false;
+    }
+    if (header().version != VERSION) {
+        error = path + " has unsupported version " + to_string(header().version);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Checkpoint::MappedFile::close()
+{
+#ifdef CHECKPOINT_MMAP
+    if (m_mapped) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    m_buffer.clear();
+}
+
+const void* Checkpoint::MappedFile::section(const char tag[4], size_t elementSize, size_t& count) const
+{
+    // Few sections, so a walk from the front is as good as an index
+    size_t offset = alignUp(sizeof(Header));
+    for (uint32_t s = 0; s < header().sections; ++s) {
+        if (offset + sizeof(SectionHeader) > m_size) {
+            return nullptr;
+        }
+        SectionHeader section;
+        memcpy(&section, m_data + offset, sizeof(section));
+        const size_t start = alignUp(offset + sizeof(SectionHeader));
+        const uint64_t bytes = (uint64_t)section.elementSize * section.count;
+        if (start > m_size || bytes > m_size - start) {
+            return nullptr;
+        }
+        if (memcmp(section.tag, tag, 4) == 0) {
+            if (section.elementSize != elementSize) {
+                return nullptr;
+            }
+            count = (size_t)section.count;
+            return m_data + start;
+        }
+        offset = alignUp(start + (size_t)bytes);
+    }
+    return nullptr;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+///Flat binary checkpoint files: a fixed header, then one section per array.
+///    Header      (see below), at offset 0
+///    sections    each: tag (4 chars), u32 element size, u64 element count,
+///                then the elements, starting on a 64 byte boundary
+///Everything is in host byte order; the header's byteOrder field tells a
+///foreign file apart.  Because every array starts aligned, a reader can map
+///the file and copy (or point) straight at the elements without parsing.
+namespace Checkpoint
+{
+    const char MAGIC[4] = { 'P', 'C', 'K', 'P' };
+    const uint32_t VERSION = 1;
+    const uint32_t ENDIAN_MARK = 0x01020304;
+    const size_t ALIGNMENT = 64;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t realSize;          //sizeof(Real) of the build that wrote it
+        uint64_t particles;
+        uint64_t nextId;
+        double clock;
+        uint32_t step;
+        float stepDt;
+        //the ShapeLibrary the shape offsets point into
+        int32_t minPoints;
+        int32_t maxPoints;
+        int32_t variants;
+        uint32_t sections;
+        uint64_t library;           //ShapeLibrary::getChecksum
+    };
+
+    ///Writes a checkpoint front to back.  Arrays are streamed out in blocks
+    ///straight from their storage, so saving needs no second copy of the state.
+    class Writer
+    {
+    public:
+        Writer() = default;
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        ///Create path and write header (sections is filled in by finish)
+        bool open(const string& path, const Header& header);
+
+        ///Append count elements of elementSize bytes from data under tag
+        void section(const char tag[4], const void* data, size_t elementSize, size_t count);
+
+        template <typename T>
+        void section(const char tag[4], const vector<T>& v) { section(tag, v.data(), sizeof(T), v.size()); }
+
+        ///Patch the section count into the header and close; false if any write failed
+        bool finish();
+
+    private:
+        FILE* m_file = nullptr;
+        Header m_header;
+        uint64_t m_offset = 0;
+        bool m_failed = false;
+
+        void write(const void* data, size_t bytes);
+        void pad();
+    };
+
+    ///A checkpoint mapped read-only into memory (read into a buffer where
+    ///mmap is not available)
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ///Map path and check its header; on failure error says why
+        bool open(const string& path, string& error);
+        void close();
+
+        const Header& header() const { return *reinterpret_cast<const Header*>(m_data); }
+
+        ///The elements of section tag, or nullptr if the file has none or its
+        ///element size is not elementSize; count receives the element count
+        const void* section(const char tag[4], size_t elementSize, size_t& count) const;
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        bool m_mapped = false;
+        vector<uint8_t> m_buffer;
+    };
+}
@@ -0,0 +1,52 @@
+#include "Emitter.h"
+#include "Particle.h" // For TTL
+#include <algorithm> // For max, remove_if
+
+Emitter Emitter::point(Vector2f position, int count)
+{
+    return { POINT, position, count, 0.0f, 0.0f, 1 };
+}
+
+Emitter Emitter::burst(Vector2f position, int count, float interval, int shots)
+{
+    // A zero interval would fire forever within one tick
+    return { BURST, position, count, 0.0f, max(interval, 1e-3f), shots };
+}
+
+Emitter Emitter::continuous(Vector2f position, float rate)
+{
+    return { CONTINUOUS, position, 0, max(rate, 0.0f), 0.0f, 0 };
+}
+
+double Emitter::steadyCount() const
+{
+    switch (kind) {
+    case BURST:
+        // Every shot still alive: those of the last TTL seconds
+        return (double)count * (shots > 0 ? min((double)shots, TTL / interval + 1.0) : TTL / interval + 1.0);
+    case CONTINUOUS:
+        return (double)rate * TTL;
+    default:
+        return count;
+    }
+}
+
+void EmitterSet::add(uint32_t id, const Emitter& emitter)
+{
+    m_active.push_back({ id, emitter, 0.0, 0 });
+}
+
+void EmitterSet::remove(uint32_t id)
+{
+    m_active.erase(remove_if(m_active.begin(), m_active.end(), [id](const Active& a) { return a.id == id; }),
+                   m_active.end());
+}
+
+double EmitterSet::steadyCount() const
+{
+    double count = 0.0;
+    for (const Active& a : m_active) {
+        count += a.emitter.steadyCount();
+    }
+    return count;
+}
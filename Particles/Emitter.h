@@ -0,0 +1,107 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+using namespace sf;
+using namespace std;
+
+///A source of particles the simulation fires by itself, every tick, without
+///waiting for clicks.
+///    POINT        count particles once, on the next tick
+///    BURST        count particles every interval seconds, shots times (0 = forever)
+///    CONTINUOUS   rate particles per second, spread over the ticks
+///Every shot is one bulk ParticleSystem::spawn of all its particles.
+struct Emitter
+{
+    enum Kind : uint8_t
+    {
+        POINT,
+        BURST,
+        CONTINUOUS
+    };
+
+    Kind kind;
+    Vector2f position;      //Cartesian coordinates
+    int count;              //particles per shot (POINT, BURST)
+    float rate;             //particles per second (CONTINUOUS)
+    float interval;         //seconds between shots (BURST)
+    int shots;              //shots before a BURST emitter is done, 0 = forever
+
+    static Emitter point(Vector2f position, int count);
+    static Emitter burst(Vector2f position, int count, float interval, int shots = 0);
+    static Emitter continuous(Vector2f position, float rate);
+
+    ///Live particles the emitter keeps up once it has run for a TTL
+    double steadyCount() const;
+};
+
+///The emitters of one simulation and where each one is in its schedule.
+///Only ever touched by the thread that runs the ticks.
+class EmitterSet
+{
+public:
+    void add(uint32_t id, const Emitter& emitter);
+    void remove(uint32_t id);
+    void clear() { m_active.clear(); }
+
+    size_t size() const { return m_active.size(); }
+
+    ///Live particles every emitter together keeps up; what to reserve for
+    double steadyCount() const;
+
+    ///Move every emitter dt seconds on, calling fire(position, count) for
+    ///each shot that falls due, in the order the emitters were added.
+    ///Emitters with no shots left are dropped.
+    template <typename Fire>
+    void advance(float dt, const Fire& fire)
+    {
+        size_t kept = 0;
+        for (size_t e = 0; e < m_active.size(); ++e) {
+            Active& a = m_active[e];
+            const Emitter& emitter = a.emitter;
+            bool done = false;
+            switch (emitter.kind) {
+            case Emitter::POINT:
+                fire(emitter.position, emitter.count);
+                done = true;
+                break;
+            case Emitter::BURST:
+                // The first shot goes off on the tick the emitter is added
+                a.timer -= dt;
+                while (a.timer <= 0.0 && !done) {
+                    fire(emitter.position, emitter.count);
+                    a.timer += emitter.interval;
+                    ++a.fired;
+                    done = emitter.shots > 0 && a.fired >= emitter.shots;
+                }
+                break;
+            case Emitter::CONTINUOUS: {
+                // Carry the fraction over so the long-run rate is exact
+                a.timer += (double)emitter.rate * dt;
+                const int count = (int)a.timer;
+                if (count > 0) {
+                    fire(emitter.position, count);
+                    a.timer -= count;
+                }
+                break;
+            }
+            }
+            if (!done) {
+                m_active[kept++] = a;
+            }
+        }
+        m_active.resize(kept);
+    }
+
+private:
+    struct Active
+    {
+        uint32_t id;
+        Emitter emitter;
+        double timer;       //BURST: seconds to the next shot; CONTINUOUS: particles owed
+        int fired;
+    };
+
+    vector<Active> m_active;
+};
@@ -1,57 +1,255 @@
 #include<iostream>
 #include "Engine.h" // header file for the Engine class
+#include "AllocStats.h" // For the heap counters on the HUD
 #include "Particle.h"
+#include "Profiler.h" // For the per-phase timers and the HUD
 #include "SFML/Graphics.hpp" // For RenderWindow and VideoMode
-#include<random>
+#include <cstdio> // For snprintf
+#include <cstdlib> // For getenv
 using namespace sf; // Use the SFML namespace globally
 using namespace std;
 
-Engine::Engine() {
+namespace
+{
+    // The window's governor aims for 60 fps unless told otherwise
+    const double DEFAULT_FRAME_BUDGET_MS = 1000.0 / 60.0;
+    // A tick slower than its own step makes the simulation fall behind
+    const double TICK_BUDGET_MS = 1000.0 * Simulation::FIXED_DT;
+}
+
+Engine::Engine(unsigned threadCount, uint64_t seed, unsigned renderThreadCount)
+    : m_simulation(threadCount), m_pool(renderThreadCount), m_rasterizer(m_pool), m_softwareRendering(false), m_rasterized(false),
+      m_governor(DEFAULT_FRAME_BUDGET_MS, TICK_BUDGET_MS), m_headless(false), m_showHud(false), m_hudFontLoaded(false),
+      m_replaying(false), m_replayDone(false), m_replayRecordPending(false), m_replayOffset(0.0) {
+    // Seed every random stream up front so a run can be reproduced with --seed
+    if (seed == 0) {
+        seed = Random::timeSeed();
+    }
+    Random::setSeed(seed);
+    m_simulation.reseed();
+    cout << "Random seed: " << seed << endl;
    
-    m_Window.create(VideoMode::getDesktopMode(), "Particles"); 
+    m_Window.reset(new RenderWindow(VideoMode::getDesktopMode(), "Particles"));
+    m_windowBackend.reset(new TargetBackend(*m_Window));
+    m_frameTexture.reset(new Texture());
+    m_frameSprite.reset(new Sprite());
+    m_view.setSize(m_Window->getSize());
+    m_simulation.setViewport(m_Window->getSize());
+
+    loadHudFont();
 
     
 }
 
+Engine::Engine(Vector2u viewport, unsigned threadCount, uint64_t seed)
+    : m_view(viewport), m_simulation(threadCount), m_pool(threadCount), m_rasterizer(m_pool), m_softwareRendering(false), m_rasterized(false),
+      m_governor(0.0, TICK_BUDGET_MS), m_headless(true), m_showHud(false), m_hudFontLoaded(false),
+      m_replaying(false), m_replayDone(false), m_replayRecordPending(false), m_replayOffset(0.0) {
+    Random::setSeed(seed);
+    m_simulation.reseed();
+    m_simulation.setViewport(viewport);
+    // No window, and none of the SFML objects that would want an OpenGL
+    // context: the simulation is driven through spawnClick / step / buildFrame
+    // There is no frame loop to drain the profiler either, so leave it off
+    Profiler::setEnabled(false);
+}
+
 void Engine::run() {
-    // Construct a local Clock object to track time per frame 
-    Clock clock;
+    if (m_headless) {
+        cerr << "Engine::run needs a window; drive a headless Engine with step()" << endl;
+        return;
+    }
 
     // Unit Tests setup and call (Use the exact code provided) 
     cout << "Starting Particle unit tests..." << endl;
    
-    Particle p(m_Window, 4, { (int)m_Window.getSize().x / 2, (int)m_Window.getSize().y / 2 });
+    Particle p(m_view, 4, { (int)m_Window->getSize().x / 2, (int)m_Window->getSize().y / 2 });
     p.unitTests();
     cout << "Unit tests complete. Starting engine..." << endl;
 
-    // Game Loop 
-    while (m_Window.isOpen()) { // Loop while m_Window is open 
-        // Restart the clock (this returns the time elapsed since the last frame) 
-        Time dt = clock.restart();
+    // Physics runs on its own thread at a fixed rate from here on; this
+    // thread only handles input and draws whatever the simulation last published.
+    // A replay runs the recorded ticks on this thread instead, as they fall due.
+    if (!m_replaying) {
+        m_simulation.start();
+    }
 
-        // Convert the clock time to seconds 
-        float dtAsSeconds = dt.asSeconds(); // Time differential (dt) 
+    // Whatever the loop allocates outside the renderer and the simulation
+    ALLOC_SCOPE(AllocStats::ENGINE);
+
+    // Game Loop 
+    while (m_Window->isOpen()) { // Loop while m_Window is open 
+        Profiler::beginFrame();
 
         // Call input 
         input();
-
-        // Call update 
-        update(dtAsSeconds);
+        if (m_replaying) {
+            pumpReplay();
+        }
 
         // Call draw 
         draw();
+
+        // Collect this frame's timings from every thread
+        Profiler::endFrame();
+        AllocStats::endFrame(m_simulation.getParticleCount());
+    }
+
+    m_simulation.stop();
+
+    if (m_recorder.isOpen()) {
+        m_recorder.finish(m_simulation.getTick(), m_simulation.checksum());
+        cout << "Recorded " << m_simulation.getTick() << " ticks" << endl;
+    }
+}
+
+bool Engine::startRecording(const string& path) {
+    if (!m_recorder.open(path, Random::getSeed())) {
+        cerr << "Cannot record to " << path << endl;
+        return false;
+    }
+    m_simulation.setRecorder(&m_recorder);
+    cout << "Recording input to " << path << endl;
+    return true;
+}
+
+bool Engine::startReplay(const string& path) {
+    string error;
+    if (!m_replay.load(path, error)) {
+        cerr << "Replay: " << error << endl;
+        return false;
+    }
+    // Same seed as the recording, then the recorded settings replace the live ones
+    Random::setSeed(m_replay.getSeed());
+    m_simulation.reseed();
+    m_replaying = true;
+    cout << "Replaying " << path << " (seed " << m_replay.getSeed() << ")" << endl;
+    return true;
+}
+
+bool Engine::loadCheckpoint(const string& path) {
+    string error;
+    if (!m_simulation.loadCheckpoint(path, error)) {
+        cerr << "Restore: " << error << endl;
+        return false;
+    }
+    cout << "Restored " << m_simulation.getParticleCount() << " particles from " << path << endl;
+    return true;
+}
+
+bool Engine::saveCheckpoint(const string& path) {
+    if (!m_simulation.saveCheckpoint(path)) {
+        cerr << "Could not write checkpoint " << path << endl;
+        return false;
+    }
+    cout << "Saved " << m_simulation.getParticleCount() << " particles to " << path << endl;
+    return true;
+}
+
+void Engine::pumpReplay() {
+    if (m_replayDone) {
+        return;
+    }
+
+    const double now = m_replayClock.getElapsedTime().asSeconds();
+    InputLog::Record& record = m_replayRecord;
+    while (true) {
+        if (!m_replayRecordPending) {
+            if (!m_replay.next(record)) {
+                cout << (m_replay.atEnd() ? "Replay ended without an END record; final state not verified"
+                                          : "Replay stopped at a corrupt record") << endl;
+                m_replayDone = true;
+                return;
+            }
+            m_replayRecordPending = true;
+        }
+
+        if (record.type == InputLog::TICK) {
+            // Keep the recorded pace: hold a tick back until its time comes
+            if (m_simulation.getTick() == 0) {
+                m_replayOffset = record.time - now;
+            }
+            if (record.time - m_replayOffset > now) {
+                return;
+            }
+            m_simulation.tick(record.dt);
+        }
+        else if (record.type == InputLog::SPAWN) {
+            if (!m_simulation.requestSpawn(record.center, record.count)) {
+                cout << "Replay stopped: more spawns in one tick than the input queue holds" << endl;
+                m_replayDone = true;
+                return;
+            }
+        }
+        else if (record.type == InputLog::VIEWPORT) {
+            m_simulation.setViewport(record.viewport);
+        }
+        else if (record.type == InputLog::COLLISIONS) {
+            m_simulation.setCollisions(record.on);
+        }
+        else if (record.type == InputLog::END) {
+            const bool match = record.ticks == m_simulation.getTick() && record.checksum == m_simulation.checksum();
+            cout << "Replay finished after " << m_simulation.getTick() << " ticks: checksum "
+                 << (match ? "matches" : "MISMATCH") << endl;
+            m_replayDone = true;
+            return;
+        }
+        m_replayRecordPending = false;
     }
 }
 
 void Engine::input()
 {
+    PROFILE_SCOPE("input");
+
     Event event;
-    while (m_Window.pollEvent(event)) {
+    while (m_Window->pollEvent(event)) {
         // Handle closing and Escape key
         if (event.type == Event::Closed ||
             (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape))
         {
-            m_Window.close();
+            m_Window->close();
+        }
+
+        // Profiler hotkeys
+        if (event.type == Event::KeyPressed) {
+            if (event.key.code == Keyboard::F4 && !m_replaying) {
+                m_simulation.setCollisions(!m_simulation.getCollisions());
+            }
+            else if (event.key.code == Keyboard::F3) {
+                m_showHud = !m_showHud;
+                if (!m_showHud && !m_hudFontLoaded) {
+                    m_Window->setTitle("Particles");
+                }
+            }
+            else if (event.key.code == Keyboard::F5) {
+                dumpProfile(false);
+            }
+            else if (event.key.code == Keyboard::F6) {
+                dumpProfile(true);
+            }
+            else if (event.key.code == Keyboard::F7) {
+                // Saved by the simulation thread once its current tick is done
+                m_simulation.requestCheckpoint("checkpoint.pchk");
+            }
+            else if (event.key.code == Keyboard::F8) {
+                m_softwareRendering = !m_softwareRendering;
+            }
+            else if (event.key.code == Keyboard::F9) {
+                saveFrame("frame.png");
+            }
+            else if (event.key.code == Keyboard::C && !m_replaying) {
+                m_simulation.clearEmitters();
+            }
+        }
+
+        // Keep pixels 1:1 with the window and recompute the Cartesian mapping once
+        if (event.type == Event::Resized) {
+            m_Window->setView(View(FloatRect(0.0f, 0.0f, (float)event.size.width, (float)event.size.height)));
+            m_view.setSize(Vector2u(event.size.width, event.size.height));
+            if (!m_replaying) {
+                m_simulation.setViewport(m_view.getSize());
+            }
         }
 
         // Handle the left mouse button pressed event
@@ -59,48 +257,217 @@ void Engine::input()
             Vector2i mouseClickPosition(event.mouseButton.x, event.mouseButton.y);
 
             // Create 5 particles
-            for (int i = 0; i < 5; ++i) {
-                // Generate random numPoints in the range [25:50]
-                int numPoints = (rand() % 26) + 25;
+            spawnClick(mouseClickPosition, 5);
+        }
 
-                // Construct and add the new particle
-                m_particles.emplace_back(m_Window, numPoints, mouseClickPosition);
-            }
+        // Right click leaves a fountain behind: 1000 particles a second until C clears it
+        if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Right && !m_replaying) {
+            Vector2i pixel(event.mouseButton.x, event.mouseButton.y);
+            m_simulation.addEmitter(Emitter::continuous(m_view.pixelToCoords(pixel), 1000.0f));
         }
     }
 }
 
-void Engine::update(float dtAsSeconds) {
-    // Loop through m_particles and call update on each Particle 
-    // Use an iterator-based for-loop for safe erasure 
-    for (auto it = m_particles.begin(); it != m_particles.end(); /* No increment here */) { // 
-        // if getTTL() > 0.0 
-        if (it->getTTL() > 0.0f) {
-            // Call update on that Particle 
-            it->update(dtAsSeconds); // Pass in the time differential (dt) 
-            // Increment the iterator 
-            ++it;
-        }
-        else {
-            // If particle's ttl has expired, erase it from the vector 
-            // erase returns an iterator that points to the next element 
-            it = m_particles.erase(it); // Assign the iterator to this return value 
-            // Do not increment the iterator here 
-        }
+void Engine::spawnClick(Vector2i pixel, int count) {
+    // A replay only takes the recorded clicks
+    if (m_replaying) {
+        return;
     }
+    // Map the click on this thread, where the view lives, and hand it over
+    // through the simulation's lock-free queue; its next tick adds the particles
+    m_simulation.requestSpawn(m_view.pixelToCoords(pixel), count);
 }
 
 void Engine::draw() {
+    PROFILE_SCOPE("draw");
+    ALLOC_SCOPE(AllocStats::RENDER);
+
+    // Both backends take the same vertex buffer
+    RenderBackend& backend = m_softwareRendering ? static_cast<RenderBackend&>(m_rasterizer) : *m_windowBackend;
+    if (m_softwareRendering) {
+        m_rasterizer.setSize(m_Window->getSize());
+    }
+
     // clear the window 
-    m_Window.clear(sf::Color::Black); // Using black for the background, as shown in the image 
+    backend.clear(sf::Color::Black); // Using black for the background, as shown in the image 
 
-    // Loop through each Particle in m_Particles 
-    for (const auto& particle : m_particles) {
-        // Pass each element into m_Window.draw() 
-        // This will call Particle::draw() due to polymorphism (since Particle inherits from sf::Drawable) 
-        m_Window.draw(particle);
+    // Fill the persistent vertex buffer with every particle's triangles,
+    // then submit them all in a single draw call
+    m_renderClock.restart();
+    buildFrame();
+    backend.drawTriangles(m_vertexBuffer.data(), m_vertexBuffer.size());
+    if (m_softwareRendering) {
+        m_rasterized = true;
+        showFramebuffer();
+    }
+    // Only the work that grows with the particles counts, not the wait for vsync
+    govern(m_renderClock.getElapsedTime().asMicroseconds() / 1000.0);
+
+    if (m_showHud) {
+        ALLOC_SCOPE(AllocStats::ENGINE);
+        updateHud();
+        if (m_hudFontLoaded) {
+            m_Window->draw(*m_hudText);
+        }
     }
 
     // display the window 
-    m_Window.display();
-}
\ No newline at end of file
+    m_Window->display();
+}
+
+void Engine::showFramebuffer() {
+    const Vector2u size = m_rasterizer.getSize();
+    if (m_frameTexture->getSize() != size) {
+        m_frameTexture->create(size.x, size.y);
+        m_frameSprite->setTexture(*m_frameTexture, true);
+    }
+    m_frameTexture->update(m_rasterizer.getPixels());
+    m_Window->clear(Color::Black);
+    m_Window->draw(*m_frameSprite);
+}
+
+void Engine::rasterizeFrame() {
+    ALLOC_SCOPE(AllocStats::RENDER);
+    m_rasterizer.setSize(m_view.getSize());
+    m_rasterizer.clear(Color::Black);
+    m_rasterizer.drawTriangles(m_vertexBuffer.data(), m_vertexBuffer.size());
+    m_rasterized = true;
+}
+
+bool Engine::saveFrame(const string& path) {
+    if (!m_rasterized) {
+        rasterizeFrame();
+    }
+    if (!m_rasterizer.writeImage(path)) {
+        cerr << "Could not write " << path << endl;
+        return false;
+    }
+    cout << "Wrote the frame to " << path << endl;
+    return true;
+}
+
+void Engine::buildFrame() {
+    ALLOC_SCOPE(AllocStats::RENDER);
+    SnapshotExchange& snapshots = m_simulation.snapshots();
+    snapshots.acquire();
+    const Snapshot& previous = snapshots.previous();
+    const Snapshot& current = snapshots.current();
+
+    // Draw the moment between the last two ticks that matches the wall clock.
+    // Headless runs step by hand and always show the latest tick.
+    float alpha = 1.0f;
+    if (!m_headless && current.time > previous.time) {
+        alpha = (float)((m_simulation.now() - previous.time) / (current.time - previous.time));
+    }
+
+    if (m_headless) {
+        m_renderClock.restart();
+    }
+    buildTriangles(previous, current, alpha, m_view, m_vertexBuffer, m_pool,
+                   m_governor.getLodEdgePixels(), m_triangleStart);
+    m_rasterized = false;
+    if (m_headless) {
+        govern(m_renderClock.getElapsedTime().asMicroseconds() / 1000.0);
+    }
+}
+
+void Engine::setMaxParticles(size_t count) {
+    m_governor.setMaxParticles(count);
+    m_simulation.setParticleCap(m_replaying ? 0 : m_governor.getParticleCap());
+}
+
+void Engine::govern(double renderMs) {
+    m_governor.observe(renderMs, m_simulation.getTickMs(), m_simulation.getParticleCount());
+    // A replay must spawn exactly what was recorded, so it only ever loses detail
+    m_simulation.setParticleCap(m_replaying ? 0 : m_governor.getParticleCap());
+}
+
+void Engine::loadHudFont() {
+    // SFML ships no default font: try $PARTICLES_FONT, then common system fonts
+    const char* candidates[] = {
+        getenv("PARTICLES_FONT"),
+        "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+        "/usr/share/fonts/TTF/DejaVuSans.ttf",
+        "/System/Library/Fonts/Supplemental/Arial.ttf",
+        "C:/Windows/Fonts/arial.ttf",
+    };
+    m_hudFont.reset(new Font());
+    m_hudText.reset(new Text());
+    for (const char* path : candidates) {
+        if (path != nullptr && m_hudFont->loadFromFile(path)) {
+            m_hudFontLoaded = true;
+            break;
+        }
+    }
+
+    m_hudText->setFont(*m_hudFont);
+    m_hudText->setCharacterSize(16);
+    m_hudText->setFillColor(Color::White);
+    m_hudText->setPosition(10.0f, 10.0f);
+}
+
+void Engine::updateHud() {
+    // Formatting strings every frame would cost more than it shows, so refresh 4 times a second
+    if (m_hudClock.getElapsedTime().asSeconds() < 0.25f) {
+        return;
+    }
+    m_hudClock.restart();
+
+    char line[256];
+    snprintf(line, sizeof(line), "%.0f fps  %.2f ms  |  %zu / %zu particles drawn  %zu vertices  |  sim %.0f Hz, tick %.2f ms  |  %zu emitters%s%s",
+             Profiler::fps(), Profiler::frameMs(), m_simulation.snapshots().current().size(),
+             m_simulation.getParticleCount(), m_vertexBuffer.size(),
+             1.0 / Simulation::FIXED_DT, m_simulation.getTickMs(), m_simulation.getEmitterCount(),
+             m_simulation.getCollisions() ? "  |  collisions" : "",
+             m_softwareRendering ? "  |  software raster" : "");
+
+    string text = line;
+    snprintf(line, sizeof(line), "%sinput latency %.1f ms", m_hudFontLoaded ? "\n" : "  |  ",
+             m_simulation.getSpawnLatencyMs());
+    text += line;
+    if (m_governor.isEnabled() || m_simulation.getParticleCap() != 0) {
+        snprintf(line, sizeof(line), "%sload %.2f  detail -%d  cap %zu  waiting %zu  dropped %llu",
+                 m_hudFontLoaded ? "\n" : "  |  ", m_governor.getLoad(), m_governor.getLevel(),
+                 m_simulation.getParticleCap(), m_simulation.getDeferredSpawns(),
+                 (unsigned long long)m_simulation.getDroppedSpawns());
+        text += line;
+    }
+    if (AllocStats::ENABLED) {
+        const AllocStats::Counters frame = AllocStats::lastFrame();
+        snprintf(line, sizeof(line), "%sheap %llu allocs %.1f KB a frame  live %.1f MB  peak %.1f MB  %.0f B/particle",
+                 m_hudFontLoaded ? "\n" : "  |  ", (unsigned long long)frame.allocations, frame.bytes / 1024.0,
+                 frame.liveBytes / 1048576.0, frame.peakBytes / 1048576.0, AllocStats::bytesPerParticle());
+        text += line;
+    }
+    for (const Profiler::PhaseTime& phase : Profiler::phaseTimes()) {
+        snprintf(line, sizeof(line), "%s%s %.2f ms", m_hudFontLoaded ? "\n" : "  |  ", phase.name, phase.ms);
+        text += line;
+    }
+
+    if (m_hudFontLoaded) {
+        m_hudText->setString(text);
+    }
+    else {
+        m_Window->setTitle("Particles  |  " + text);
+    }
+}
+
+void Engine::dumpProfile(bool trace) {
+    const char* path = trace ? "profile_trace.json" : "profile.csv";
+    bool written = trace ? Profiler::dumpTrace(path) : Profiler::dumpCsv(path);
+    if (written) {
+        cout << "Wrote the profiler history to " << path << endl;
+    }
+    else {
+        cerr << "Could not write " << path << endl;
+    }
+    // The heap figures of the same frames go next to the CSV
+    if (!trace && AllocStats::ENABLED) {
+        if (AllocStats::dumpCsv("alloc_profile.csv")) {
+            cout << "Wrote the heap history to alloc_profile.csv" << endl;
+        }
+        else {
+            cerr << "Could not write alloc_profile.csv" << endl;
+        }
+    }
+}
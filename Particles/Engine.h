@@ -1,29 +1,146 @@
 #pragma once
-#pragma once
 #include <SFML/Graphics.hpp>
+#include "CartesianView.h"
+#include "Emitter.h"
+#include "FrameGovernor.h"
+#include "InputLog.h"
 #include "Particle.h"
+#include "Random.h"
+#include "RenderBackend.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include <memory>
 using namespace sf;
 using namespace std;
 
 class Engine
 {
 private:
-	// A regular RenderWindow
-	RenderWindow m_Window;
+	// A regular RenderWindow.  It and every SFML object below that needs an
+	// OpenGL context (the frame texture, the HUD font) are only made by the
+	// windowed constructor: a headless Engine must run without a display.
+	unique_ptr<RenderWindow> m_Window;
+
+	// The Cartesian plane shared by every particle, updated on resize
+	CartesianView m_view;
+
+	//every live Particle, stepped at a fixed rate on its own thread
+	Simulation m_simulation;
+
+	//worker threads for building the frame, separate from the simulation's
+	ThreadPool m_pool;
+
+	//every particle's triangles for the current frame, reused between frames
+	vector<Vertex> m_vertexBuffer;
+	//where each particle's triangles start when drawn at reduced detail
+	vector<uint32_t> m_triangleStart;
+
+	// Where draw() sends the frame: to the window through SFML, or to the CPU
+	// rasterizer (F8, --software), whose framebuffer is then shown as a texture
+	unique_ptr<TargetBackend> m_windowBackend;
+	SoftwareRasterizer m_rasterizer;
+	bool m_softwareRendering;
+	bool m_rasterized;	// the framebuffer holds the vertex buffer's frame
+	unique_ptr<Texture> m_frameTexture;
+	unique_ptr<Sprite> m_frameSprite;
+
+	// Trades detail and admissions for frame time; off in headless runs unless asked for
+	FrameGovernor m_governor;
+	Clock m_renderClock;
 
-	//vector for Particles
-	vector<Particle> m_particles;
+	// True when running without a window (benchmarks, build machines)
+	bool m_headless;
+
+	// Profiler overlay, toggled with F3; without a font it goes in the window title
+	bool m_showHud;
+	bool m_hudFontLoaded;
+	unique_ptr<Font> m_hudFont;
+	unique_ptr<Text> m_hudText;
+	Clock m_hudClock;
+
+	// Input log being written (--record) or played back instead of clicks (--replay)
+	InputLog::Recorder m_recorder;
+	InputLog::Player m_replay;
+	bool m_replaying;
+	bool m_replayDone;
+	InputLog::Record m_replayRecord;
+	bool m_replayRecordPending;
+	double m_replayOffset;	// recorded time minus replay clock, set on the first tick
+	Clock m_replayClock;
 
 	// Private functions for internal use only
 	void input();
-	void update(float dtAsSeconds);
 	void draw();
 
+	// HUD helpers
+	void loadHudFont();
+	void updateHud();
+	// Write the profiler history for the last frames (F5: CSV, plus the heap's
+	// in an ALLOC_STATS build; F6: Chrome trace)
+	void dumpProfile(bool trace);
+	// Replay: run the recorded ticks that are due by now
+	void pumpReplay();
+	// Feed the governor this frame's render time and pass its particle cap on
+	void govern(double renderMs);
+	// Software rendering: put the framebuffer on the window
+	void showFramebuffer();
+
 public:
 	// The Engine constructor
-	Engine();
+	// threadCount is the number of simulation threads (0 = one per core, 1 = single-threaded)
+	// seed drives every random number in the run (0 = pick one from the clock and print it)
+	// renderThreadCount sizes the pool that builds each frame (0 = one per core)
+	Engine(unsigned threadCount = 0, uint64_t seed = 0, unsigned renderThreadCount = 0);
+
+	// Headless constructor: no window is created, viewport is the logical
+	// size of the Cartesian plane that clicks are mapped into.  The simulation
+	// thread is not started; step() advances it instead.
+	Engine(Vector2u viewport, unsigned threadCount, uint64_t seed = 1);
 
-	// Run will call all the private functions
+	// Run starts the simulation thread, then renders until the window closes
 	void run();
 
+	// Call before run: log every tick's inputs to path, verified by a checksum at exit
+	bool startRecording(const string& path);
+	// Call before run: play path back at its recorded pace instead of taking clicks
+	bool startReplay(const string& path);
+	// Call before run (or between headless steps): replace every particle with a saved checkpoint
+	bool loadCheckpoint(const string& path);
+	// Headless only: save every particle to a checkpoint (F7 does it in the window)
+	bool saveCheckpoint(const string& path);
+
+	// Simulation entry points shared by the window loop and headless runs
+	// Spawn count particles at a pixel position, as a left click does
+	void spawnClick(Vector2i pixel, int count = 5);
+	// Start an emitter (Cartesian coordinates); returns its id for removeEmitter
+	uint32_t addEmitter(const Emitter& emitter) { return m_simulation.addEmitter(emitter); }
+	void removeEmitter(uint32_t id) { m_simulation.removeEmitter(id); }
+	// Headless only: advance the simulation by one tick of dt seconds
+	void step(float dtAsSeconds) { m_simulation.tick(dtAsSeconds); }
+	// Build this frame's vertex buffer from the latest snapshots without presenting it
+	void buildFrame();
+	// Draw the frame buildFrame last built into the CPU framebuffer
+	void rasterizeFrame();
+	// Write the last frame to path (PNG if it ends in .png, PPM otherwise),
+	// rasterizing it on the CPU first if SFML drew it
+	bool saveFrame(const string& path);
+	// Draw through the CPU rasterizer instead of SFML (F8 toggles it in the window)
+	void setSoftwareRendering(bool on) { m_softwareRendering = on; }
+	// Particle-particle collisions, off by default (F4 toggles them in the window)
+	void setCollisions(bool on) { m_simulation.setCollisions(on); }
+	// Frame time the governor keeps to by lowering detail, then capping spawns
+	// (window default: 60 fps; 0 = off, the headless default)
+	void setFrameBudget(double ms) { m_governor.setFrameBudgetMs(ms); }
+	// Never let more than count particles live, whatever the frame time (0 = no limit)
+	void setMaxParticles(size_t count);
+
+	bool isHeadless() const { return m_headless; }
+	unsigned getThreadCount() const { return m_simulation.getThreadCount(); }
+	Vector2u getViewportSize() const { return m_view.getSize(); }
+	size_t getParticleCount() const { return m_simulation.getParticleCount(); }
+	size_t getVertexCount() const { return m_vertexBuffer.size(); }
+	const SoftwareRasterizer& getRasterizer() const { return m_rasterizer; }
+
 };
\ No newline at end of file
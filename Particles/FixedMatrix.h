@@ -0,0 +1,231 @@
+#ifndef FIXED_MATRIX_H_INCLUDED
+#define FIXED_MATRIX_H_INCLUDED
+
+#include <cmath>
+#include "Matrices.h"
+
+///Fixed-size matrices and fused 2xN coordinate expressions.
+///
+///Mat<R,C,T> is the compile-time counterpart of Matrix: dimensions are template
+///parameters, storage is inline and column-major, and a size mismatch is a
+///compile error instead of a runtime exception.  rotation / scaling build the
+///2x2 transforms without touching the heap.
+///
+///The expression templates work on 2xN coordinate buffers (the interleaved
+///(x,y) layout of a 2xN Matrix).  Writing
+///    assign(A, translation(x, y) + rotation(t) * (scaling(s) * columns(A)));
+///builds a small tree of nodes; assign then walks the columns once, each
+///column evaluated through the whole tree in registers, so no intermediate
+///matrix is ever created.  Every node reads only its own column, so the
+///destination may also appear on the right hand side.  All the leaves of one
+///expression share a scalar type: use Real to match Matrix.
+namespace Matrices
+{
+    template <int R, int C, typename T = double>
+    class Mat
+    {
+        public:
+            static constexpr int rows = R;
+            static constexpr int cols = C;
+
+            ///Every element 0
+            constexpr Mat() : a{} {}
+
+            ///Unchecked element access; (i,j) lives at a[j * R + i] like Matrix
+            constexpr const T& operator()(int i, int j) const { return a[j * R + i]; }
+            constexpr T& operator()(int i, int j) { return a[j * R + i]; }
+
+            constexpr const T* data() const { return a; }
+            constexpr T* data() { return a; }
+
+            ///Copy into a dynamic Matrix, for callers of the old API
+            Matrix toMatrix() const
+            {
+                Matrix m(R, C);
+                for (int k = 0; k < R * C; ++k) {
+                    m.data()[k] = (double)a[k];
+                }
+                return m;
+            }
+
+        private:
+            T a[R * C];
+    };
+
+    typedef Mat<2, 2, double> Mat2;
+
+    ///Fixed-size product; inner dimensions must agree at compile time
+    template <int R, int K, int C, typename T>
+    constexpr Mat<R, C, T> operator*(const Mat<R, K, T>& x, const Mat<K, C, T>& y)
+    {
+        Mat<R, C, T> c;
+        for (int j = 0; j < C; ++j) {
+            for (int k = 0; k < K; ++k) {
+                for (int i = 0; i < R; ++i) {
+                    c(i, j) += x(i, k) * y(k, j);
+                }
+            }
+        }
+        return c;
+    }
+
+    template <int R, int C, typename T>
+    constexpr bool operator==(const Mat<R, C, T>& x, const Mat<R, C, T>& y)
+    {
+        for (int k = 0; k < R * C; ++k) {
+            if (x.data()[k] != y.data()[k]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ///Rotation by the angle whose cosine and sine are c and s;
+    ///usable in constant expressions
+    template <typename T = double>
+    constexpr Mat<2, 2, T> rotation(T c, T s)
+    {
+        Mat<2, 2, T> r;
+        r(0, 0) = c;
+        r(0, 1) = -s;
+        r(1, 0) = s;
+        r(1, 1) = c;
+        return r;
+    }
+
+    ///Same layout as RotationMatrix(theta): theta radians counter-clockwise
+    template <typename T = double>
+    inline Mat<2, 2, T> rotation(T theta)
+    {
+        return rotation<T>(std::cos(theta), std::sin(theta));
+    }
+
+    ///Same layout as ScalingMatrix(scale)
+    template <typename T = double>
+    constexpr Mat<2, 2, T> scaling(T scale)
+    {
+        Mat<2, 2, T> m;
+        m(0, 0) = scale;
+        m(1, 1) = scale;
+        return m;
+    }
+
+    ///One (x,y) column, the value every expression node yields
+    template <typename T>
+    struct Column
+    {
+        T x;
+        T y;
+    };
+
+    ///Base of every 2xN expression node (CRTP).  Only types deriving from it
+    ///take part in the operators below, so Matrix arithmetic is untouched.
+    template <typename E>
+    struct ColumnExpr
+    {
+        const E& self() const { return static_cast<const E&>(*this); }
+    };
+
+    ///Leaf: the columns of an existing coordinate buffer
+    template <typename T>
+    struct ColumnsView : ColumnExpr<ColumnsView<T>>
+    {
+        const T* data;
+        int count;
+
+        ColumnsView(const T* d, int n) : data(d), count(n) {}
+        Column<T> operator()(int j) const { return { data[2 * j], data[2 * j + 1] }; }
+        int cols() const { return count; }
+    };
+
+    ///Leaf: the same (x,y) in every column, i.e. a TranslationMatrix of any width
+    template <typename T>
+    struct Translation : ColumnExpr<Translation<T>>
+    {
+        T x;
+        T y;
+
+        Translation(T xShift, T yShift) : x(xShift), y(yShift) {}
+        Column<T> operator()(int) const { return { x, y }; }
+        ///broadcasts, so it never decides the width of an expression
+        int cols() const { return -1; }
+    };
+
+    ///Node: fixed 2x2 matrix times an expression
+    template <typename T, typename E>
+    struct Product : ColumnExpr<Product<T, E>>
+    {
+        Mat<2, 2, T> m;
+        E e;
+
+        Product(const Mat<2, 2, T>& matrix, const E& expr) : m(matrix), e(expr) {}
+        Column<T> operator()(int j) const
+        {
+            Column<T> v = e(j);
+            return { m(0, 0) * v.x + m(0, 1) * v.y, m(1, 0) * v.x + m(1, 1) * v.y };
+        }
+        int cols() const { return e.cols(); }
+    };
+
+    ///Node: element-wise sum of two expressions
+    template <typename L, typename R>
+    struct Sum : ColumnExpr<Sum<L, R>>
+    {
+        L l;
+        R r;
+
+        Sum(const L& left, const R& right) : l(left), r(right) {}
+        auto operator()(int j) const -> decltype(l(j))
+        {
+            auto u = l(j);
+            auto v = r(j);
+            return { u.x + v.x, u.y + v.y };
+        }
+        int cols() const { return l.cols() >= 0 ? l.cols() : r.cols(); }
+    };
+
+    ///View a 2xN Matrix, or any interleaved buffer of n (x,y) pairs, as an expression
+    inline ColumnsView<Real> columns(const Matrix& m) { return ColumnsView<Real>(m.data(), m.getCols()); }
+    template <typename T>
+    ColumnsView<T> columns(const T* data, int n) { return ColumnsView<T>(data, n); }
+
+    template <typename T>
+    Translation<T> translation(T xShift, T yShift) { return Translation<T>(xShift, yShift); }
+
+    template <typename T, typename E>
+    Product<T, E> operator*(const Mat<2, 2, T>& m, const ColumnExpr<E>& e)
+    {
+        return Product<T, E>(m, e.self());
+    }
+
+    template <typename L, typename R>
+    Sum<L, R> operator+(const ColumnExpr<L>& l, const ColumnExpr<R>& r)
+    {
+        return Sum<L, R>(l.self(), r.self());
+    }
+
+    ///Evaluate e into the interleaved buffer out, one fused pass over n columns
+    template <typename T, typename E>
+    void assign(T* out, int n, const ColumnExpr<E>& e)
+    {
+        const E& expr = e.self();
+        for (int j = 0; j < n; ++j) {
+            Column<T> v = expr(j);
+            out[2 * j] = v.x;
+            out[2 * j + 1] = v.y;
+        }
+    }
+
+    ///Evaluate e into the 2xN Matrix out
+    template <typename E>
+    void assign(Matrix& out, const ColumnExpr<E>& e)
+    {
+        if (out.getRows() != 2 || (e.self().cols() >= 0 && e.self().cols() != out.getCols()))
+        {
+            throw std::runtime_error("Error: Matrix assignment requires a 2xN destination as wide as the expression.");
+        }
+        assign(out.data(), out.getCols(), e);
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+
+void* FrameArena::allocate(size_t bytes, size_t alignment)
+{
+    for (;;) {
+        if (m_current < m_blocks.size()) {
+            Block& block = m_blocks[m_current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t start = ((base + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+            if (start + bytes <= block.size) {
+                m_used += start + bytes - m_offset;
+                m_offset = start + bytes;
+                return block.data.get() + start;
+            }
+            // Try the next kept block, if any
+            ++m_current;
+            m_offset = 0;
+            continue;
+        }
+
+        // Out of blocks: add one at least twice the largest so far
+        size_t size = max(m_initialBytes, bytes + alignment);
+        if (!m_blocks.empty()) {
+            size = max(size, 2 * m_blocks.back().size);
+        }
+        m_blocks.push_back({ unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+        m_current = m_blocks.size() - 1;
+        m_offset = 0;
+    }
+}
+
+void FrameArena::reset()
+{
+    m_peak = max(m_peak, m_used);
+
+    // A frame that spilled into several blocks gets one block big enough for
+    // the whole peak, so the next frames bump through a single block again
+    if (m_blocks.size() > 1) {
+        size_t size = max(m_initialBytes, 2 * m_peak);
+        m_blocks.clear();
+        m_blocks.push_back({ unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+    }
+
+    m_current = 0;
+    m_offset = 0;
+    m_used = 0;
+}
+
+size_t FrameArena::bytesReserved() const
+{
+    size_t total = 0;
+    for (const Block& block : m_blocks) {
+        total += block.size;
+    }
+    return total;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+///Bump allocator for temporaries that live for one frame.
+///allocate() hands out consecutive slices of large blocks; reset() makes all
+///of it reusable at once.  Blocks are kept between frames and merged into one
+///block sized for the peak, so steady-state frames never touch the heap.
+///Only trivially destructible types belong here: nothing is destroyed.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t initialBytes = 64 * 1024) : m_initialBytes(initialBytes) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(max_align_t));
+
+    ///Uninitialized storage for n objects of type T
+    template <typename T>
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    ///Release every allocation since the last reset
+    void reset();
+
+    size_t bytesUsed() const { return m_used; }
+    size_t bytesReserved() const;
+
+private:
+    struct Block
+    {
+        unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    size_t m_initialBytes;
+    vector<Block> m_blocks;
+    size_t m_current = 0;   //block being bumped
+    size_t m_offset = 0;    //next free byte in it
+    size_t m_used = 0;      //bytes handed out since reset
+    size_t m_peak = 0;      //largest m_used seen, including alignment
+};
@@ -0,0 +1,76 @@
+#include "FrameGovernor.h"
+#include <algorithm>
+using namespace std;
+
+namespace
+{
+    ///Fan edge in pixels each LOD level aims for.  A new particle's edges are
+    ///6-13 pixels, and they shrink with it, so the first level only thins out
+    ///old particles and the last leaves every ring a handful of triangles.
+    const float LOD_EDGE_PIXELS[FrameGovernor::MAX_LEVEL + 1] = { 0.0f, 6.0f, 12.0f, 20.0f, 32.0f };
+}
+
+FrameGovernor::FrameGovernor(double frameBudgetMs, double tickBudgetMs)
+    : m_frameBudgetMs(frameBudgetMs), m_tickBudgetMs(tickBudgetMs)
+{
+}
+
+void FrameGovernor::setFrameBudgetMs(double ms)
+{
+    m_frameBudgetMs = ms;
+    if (!isEnabled()) {
+        m_level = 0;
+        m_cap = 0;
+    }
+}
+
+void FrameGovernor::observe(double frameMs, double tickMs, size_t particles)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    m_loadSum += max(frameMs / m_frameBudgetMs, m_tickBudgetMs > 0.0 ? tickMs / m_tickBudgetMs : 0.0);
+    if (++m_frames < WINDOW) {
+        return;
+    }
+    m_load = m_loadSum / m_frames;
+    m_loadSum = 0.0;
+    m_frames = 0;
+
+    if (m_load > HIGH_WATER) {
+        if (m_level < MAX_LEVEL) {
+            ++m_level;
+        }
+        else {
+            // Below what is alive now, or the cap would not bite until the
+            // backlog of particles had expired
+            const size_t cap = max(MIN_CAP, (size_t)(particles * CAP_SHRINK));
+            m_cap = m_cap == 0 ? cap : min(m_cap, cap);
+        }
+    }
+    else if (m_load < LOW_WATER) {
+        if (m_cap != 0) {
+            // Lift the cap once it no longer holds anything back
+            m_cap = (size_t)(m_cap * CAP_GROW);
+            if (particles < m_cap * LOW_WATER) {
+                m_cap = 0;
+            }
+        }
+        else if (m_level > 0) {
+            --m_level;
+        }
+    }
+}
+
+float FrameGovernor::getLodEdgePixels() const
+{
+    return LOD_EDGE_PIXELS[m_level];
+}
+
+size_t FrameGovernor::getParticleCap() const
+{
+    if (m_cap == 0) {
+        return m_maxParticles;
+    }
+    return m_maxParticles == 0 ? m_cap : min(m_cap, m_maxParticles);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+
+///Keeps the frame inside a time budget by trading detail, then admissions.
+///Every frame the engine reports what the frame cost to build and what a
+///simulation tick cost, each against its own budget.  Over a window of
+///frames the governor looks at the worse of the two ratios ("load"):
+///    over budget      one LOD level coarser; past the last level, cap the
+///                     particle count below what is alive now
+///    well under it    undo the last step: raise the cap, then add detail back
+///Anything in between is left alone, so the settings do not flap around
+///the budget.  A cap only turns new spawns away; particles already alive
+///are never dropped, so the count drifts down to the cap as they expire.
+class FrameGovernor
+{
+public:
+    ///LOD levels before the cap takes over
+    static const int MAX_LEVEL = 4;
+
+    ///frameBudgetMs of 0 turns the governor off (full detail, no cap of its own)
+    FrameGovernor(double frameBudgetMs, double tickBudgetMs);
+
+    void setFrameBudgetMs(double ms);
+    double getFrameBudgetMs() const { return m_frameBudgetMs; }
+    bool isEnabled() const { return m_frameBudgetMs > 0.0; }
+
+    ///Hard limit on live particles whatever the load (0 = none)
+    void setMaxParticles(size_t count) { m_maxParticles = count; }
+
+    ///One frame's measurements: milliseconds to build it, the simulation's
+    ///milliseconds per tick, and the particles alive
+    void observe(double frameMs, double tickMs, size_t particles);
+
+    int getLevel() const { return m_level; }
+    ///Fan edge length in pixels below which rings lose points (0 = full detail)
+    float getLodEdgePixels() const;
+    ///Live particles spawns may fill up to (0 = no limit)
+    size_t getParticleCap() const;
+    ///Smoothed load of the last window: 1 is exactly on budget
+    double getLoad() const { return m_load; }
+
+private:
+    double m_frameBudgetMs;
+    double m_tickBudgetMs;
+    size_t m_maxParticles = 0;
+
+    int m_level = 0;
+    size_t m_cap = 0;           //the governor's own cap, 0 while it has none
+
+    double m_loadSum = 0.0;
+    int m_frames = 0;
+    double m_load = 0.0;
+
+    ///frames per decision: long enough for a change to show in the timings
+    static constexpr int WINDOW = 15;
+    static constexpr double HIGH_WATER = 1.0;
+    static constexpr double LOW_WATER = 0.7;
+    ///each over-budget step caps this fraction of the live particles
+    static constexpr double CAP_SHRINK = 0.85;
+    static constexpr double CAP_GROW = 1.15;
+    ///the governor never caps below this many particles
+    static constexpr size_t MIN_CAP = 1000;
+};
@@ -0,0 +1,287 @@
+#include "Gemm.h"
+#include "AllocStats.h"
+#include "ThreadPool.h"
+#include "VertexKernels.h" // For the instruction set the kernels dispatch on
+#include <algorithm> // For min, fill
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    ///Register tile: MR rows of c (two 256-bit registers) by NR columns, so
+    ///the kernel keeps 2 * NR accumulators plus two of a and one of b live
+    const int LANES = 32 / (int)sizeof(Real);
+    const int MR = 2 * LANES;
+    const int NR = 6;
+
+    ///Cache blocks: a KC x NR sliver of b stays in L1 while the kernel
+    ///walks an MC x KC block of a held in L2; the KC x NC panel of b is
+    ///meant for L3.  Double: 192 KB of a, 1.9 MB of b.
+    const int KC = 256;
+    const int MC = 12 * MR;
+    const int NC = 160 * NR;
+
+    ///Below this many multiply-adds packing costs more than it saves; with
+    ///AVX2 the blocked path is already 4x faster at 16 x 16
+    const double BLOCKED_WORK = 12.0 * 12.0 * 12.0;
+    ///Below this many, waking the pool costs more than it saves
+    const double PARALLEL_WORK = 128.0 * 128.0 * 128.0;
+
+    ///c (MR x NR, leading dimension ldc) = or += a micro-panel of a times one of b
+    typedef void (*Kernel)(int kc, const Real* a, const Real* b, Real* c, int ldc, bool accumulate);
+
+    void kernelScalar(int kc, const Real* a, const Real* b, Real* c, int ldc, bool accumulate)
+    {
+        Real acc[NR][MR] = {};
+        for (int p = 0; p < kc; ++p, a += MR, b += NR) {
+            for (int j = 0; j < NR; ++j) {
+                const Real bj = b[j];
+                for (int i = 0; i < MR; ++i) {
+                    acc[j][i] += a[i] * bj;
+                }
+            }
+        }
+        for (int j = 0; j < NR; ++j) {
+            Real* cj = c + j * ldc;
+            for (int i = 0; i < MR; ++i) {
+                cj[i] = accumulate ? cj[i] + acc[j][i] : acc[j][i];
+            }
+        }
+    }
+
+#ifdef GEMM_X86
+    // The kernel's few operations for each Real, so it is written once
+    struct Avx2Double
+    {
+        typedef __m256d V;
+        __attribute__((target("avx2,fma"))) static V zero() { return _mm256_setzero_pd(); }
+        __attribute__((target("avx2,fma"))) static V load(const double* p) { return _mm256_loadu_pd(p); }
+        __attribute__((target("avx2,fma"))) static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+        __attribute__((target("avx2,fma"))) static V broadcast(const double* p) { return _mm256_broadcast_sd(p); }
+        __attribute__((target("avx2,fma"))) static V fmadd(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+        __attribute__((target("avx2,fma"))) static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    };
+
+    struct Avx2Float
+    {
+        typedef __m256 V;
+        __attribute__((target("avx2,fma"))) static V zero() { return _mm256_setzero_ps(); }
+        __attribute__((target("avx2,fma"))) static V load(const float* p) { return _mm256_loadu_ps(p); }
+        __attribute__((target("avx2,fma"))) static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+        __attribute__((target("avx2,fma"))) static V broadcast(const float* p) { return _mm256_broadcast_ss(p); }
+        __attribute__((target("avx2,fma"))) static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+        __attribute__((target("avx2,fma"))) static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    };
+
+#ifdef PARTICLES_FLOAT32
+    typedef Avx2Float Avx2;
+#else
+    typedef Avx2Double Avx2;
+#endif
+
+    // Each step loads one column of the a panel (two registers) and
+    // broadcasts the NR values of the b row against it: 2 * NR FMAs for
+    // 2 + NR loads
+    __attribute__((target("avx2,fma")))
+    void kernelAVX2(int kc, const Real* a, const Real* b, Real* c, int ldc, bool accumulate)
+    {
+        typedef Avx2::V V;
+        V c0[NR], c1[NR];
+#pragma GCC unroll 6
+        for (int j = 0; j < NR; ++j) {
+            c0[j] = Avx2::zero();
+            c1[j] = Avx2::zero();
+        }
+        for (int p = 0; p < kc; ++p, a += MR, b += NR) {
+            const V a0 = Avx2::load(a);
+            const V a1 = Avx2::load(a + LANES);
+#pragma GCC unroll 6
+            for (int j = 0; j < NR; ++j) {
+                const V bj = Avx2::broadcast(b + j);
+                c0[j] = Avx2::fmadd(a0, bj, c0[j]);
+                c1[j] = Avx2::fmadd(a1, bj, c1[j]);
+            }
+        }
+#pragma GCC unroll 6
+        for (int j = 0; j < NR; ++j) {
+            Real* cj = c + j * ldc;
+            if (accumulate) {
+                c0[j] = Avx2::add(c0[j], Avx2::load(cj));
+                c1[j] = Avx2::add(c1[j], Avx2::load(cj + LANES));
+            }
+            Avx2::store(cj, c0[j]);
+            Avx2::store(cj + LANES, c1[j]);
+        }
+    }
+#endif
+
+    Kernel chooseKernel()
+    {
+#ifdef GEMM_X86
+        // VertexKernels has already checked the CPU (and PARTICLES_SIMD)
+        if (VertexKernels::activeInstructionSet() >= VertexKernels::InstructionSet::AVX2) {
+            return kernelAVX2;
+        }
+#endif
+        return kernelScalar;
+    }
+
+    ///Copy the mc x kc block of a at `a` (leading dimension lda) into MR-row
+    ///micro-panels, each stored column by column; short panels are padded
+    ///with zeros so the kernel never needs a remainder loop
+    void packA(const Real* a, int lda, int mc, int kc, Real* packed)
+    {
+        for (int ir = 0; ir < mc; ir += MR) {
+            const int mr = min(MR, mc - ir);
+            for (int p = 0; p < kc; ++p) {
+                const Real* column = a + (size_t)p * lda + ir;
+                int i = 0;
+                for (; i < mr; ++i) {
+                    packed[i] = column[i];
+                }
+                for (; i < MR; ++i) {
+                    packed[i] = 0;
+                }
+                packed += MR;
+            }
+        }
+    }
+
+    ///Copy the kc x nc panel of b at `b` (leading dimension ldb) into NR-column
+    ///micro-panels, each stored row by row, zero-padded the same way
+    void packB(const Real* b, int ldb, int kc, int nc, Real* packed)
+    {
+        for (int jr = 0; jr < nc; jr += NR) {
+            const int nr = min(NR, nc - jr);
+            for (int j = 0; j < NR; ++j) {
+                const Real* column = b + (size_t)(jr + j) * ldb;
+                for (int p = 0; p < kc; ++p) {
+                    packed[p * NR + j] = j < nr ? column[p] : 0;
+                }
+            }
+            packed += (size_t)kc * NR;
+        }
+    }
+
+    ///One MC x NC block of c from packed a and b; edge tiles go through a
+    ///full-size scratch tile so the kernel only ever sees whole tiles
+    void macroKernel(Kernel kernel, int mc, int nc, int kc, const Real* packedA, const Real* packedB,
+                     Real* c, int ldc, bool accumulate)
+    {
+        alignas(64) Real scratch[MR * NR];
+        for (int jr = 0; jr < nc; jr += NR) {
+            const int nr = min(NR, nc - jr);
+            const Real* b = packedB + (size_t)jr * kc;
+            for (int ir = 0; ir < mc; ir += MR) {
+                const int mr = min(MR, mc - ir);
+                const Real* a = packedA + (size_t)ir * kc;
+                Real* tile = c + (size_t)jr * ldc + ir;
+                if (mr == MR && nr == NR) {
+                    kernel(kc, a, b, tile, ldc, accumulate);
+                    continue;
+                }
+                kernel(kc, a, b, scratch, MR, false);
+                for (int j = 0; j < nr; ++j) {
+                    for (int i = 0; i < mr; ++i) {
+                        Real& out = tile[(size_t)j * ldc + i];
+                        out = accumulate ? out + scratch[j * MR + i] : scratch[j * MR + i];
+                    }
+                }
+            }
+        }
+    }
+
+    void multiplyBlocked(const Real* a, const Real* b, Real* c, int m, int k, int n, ThreadPool* pool)
+    {
+        ALLOC_SCOPE(AllocStats::MATRICES);
+        const Kernel kernel = chooseKernel();
+        const bool parallel = pool != nullptr && pool->getThreadCount() > 1 && (double)m * n * k >= PARALLEL_WORK;
+        // Packing buffers live as long as their thread, so repeated products
+        // allocate nothing once they have grown
+        static thread_local vector<Real> packedB;
+        const int blocks = (m + MC - 1) / MC;
+
+        for (int jc = 0; jc < n; jc += NC) {
+            const int nc = min(NC, n - jc);
+            for (int pc = 0; pc < k; pc += KC) {
+                const int kc = min(KC, k - pc);
+                // The first slice of k overwrites c, the others add to it
+                const bool accumulate = pc > 0;
+                packedB.resize((size_t)kc * ((nc + NR - 1) / NR) * NR);
+                packB(b + (size_t)jc * k + pc, k, kc, nc, packedB.data());
+
+                const Real* panel = packedB.data();
+                auto body = [&](size_t begin, size_t end) {
+                    static thread_local vector<Real> packedA;
+                    packedA.resize((size_t)kc * MC);
+                    for (size_t block = begin; block < end; ++block) {
+                        const int ic = (int)block * MC;
+                        const int mc = min(MC, m - ic);
+                        packA(a + (size_t)pc * m + ic, m, mc, kc, packedA.data());
+                        macroKernel(kernel, mc, nc, kc, packedA.data(), panel, c + (size_t)jc * m + ic, m, accumulate);
+                    }
+                };
+                // Each block of a writes its own rows of c, so the blocks
+                // need no locking
+                if (parallel && blocks > 1) {
+                    pool->parallelFor((size_t)blocks, 1, body);
+                }
+                else {
+                    body(0, (size_t)blocks);
+                }
+            }
+        }
+    }
+
+    void multiplySmall(const Real* a, const Real* b, Real* c, int m, int k, int n)
+    {
+        fill(c, c + (size_t)m * n, (Real)0);
+        // Column-major: walk each column of b and accumulate columns of a into the
+        // matching column of the result, so every inner loop is unit-stride
+        for (int j = 0; j < n; ++j) {
+            Real* cj = c + (size_t)j * m;
+            const Real* bj = b + (size_t)j * k;
+            for (int p = 0; p < k; ++p) {
+                const Real* ap = a + (size_t)p * m;
+                const Real bpj = bj[p];
+                for (int i = 0; i < m; ++i) {
+                    cj[i] += ap[i] * bpj;
+                }
+            }
+        }
+    }
+}
+
+void Gemm::multiply(const Real* a, const Real* b, Real* c, int m, int k, int n, ThreadPool* pool)
+{
+    if (m == 0 || n == 0) {
+        return;
+    }
+    if (m == 2 && k == 2) {
+        multiply2x2(a, b, c, n);
+    }
+    else if ((double)m * n * k < BLOCKED_WORK || k == 0) {
+        multiplySmall(a, b, c, m, k, n);
+    }
+    else {
+        multiplyBlocked(a, b, c, m, k, n, pool);
+    }
+}
+
+void Gemm::multiply2x2(const Real* m, const Real* b, Real* c, int n)
+{
+    // Column-major: m = [m[0] m[2]; m[1] m[3]]
+    const Real m00 = m[0], m10 = m[1], m01 = m[2], m11 = m[3];
+    for (int j = 0; j < n; ++j) {
+        const Real x = b[2 * j];
+        const Real y = b[2 * j + 1];
+        c[2 * j] = m00 * x + m01 * y;
+        c[2 * j + 1] = m10 * x + m11 * y;
+    }
+}
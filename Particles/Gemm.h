@@ -0,0 +1,25 @@
+#pragma once
+#include "Precision.h"
+
+class ThreadPool;
+
+///General matrix multiply on raw column-major buffers, the layout of Matrix.
+///Matrices::multiply and operator* come here; use those unless the data
+///lives somewhere else.
+///
+///Small products take a plain unit-stride loop.  Large ones are blocked for
+///the caches the usual way: a KC x NC panel of b and an MC x KC block of a
+///are packed into contiguous micro-panels, and a register-tiled MR x NR
+///kernel (AVX2 + FMA when VertexKernels picked AVX2 or better, plain C++
+///otherwise) accumulates each tile of c.  With a pool, the blocks of a are
+///spread over its threads.
+namespace Gemm
+{
+    ///c (m x n) = a (m x k) * b (k x n), overwriting c.  c must not overlap
+    ///a or b.  pool may be nullptr; it is only used for large products.
+    void multiply(const Real* a, const Real* b, Real* c, int m, int k, int n, ThreadPool* pool = nullptr);
+
+    ///c (2 x n) = m (2 x 2) * b (2 x n): every column is one (x,y) pair.
+    ///c may be m or b (m is read first, each column before it is written).
+    void multiply2x2(const Real* m, const Real* b, Real* c, int n);
+}
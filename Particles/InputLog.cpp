@@ -0,0 +1,338 @@
+#include "InputLog.h"
+#include "Random.h"
+#include "Simulation.h"
+#include <chrono>
+#include <cstring> // For memcpy
+#include <iostream>
+
+namespace
+{
+    const char MAGIC[4] = { 'P', 'L', 'O', 'G' };
+
+    ///The buffer is written out once it holds this much
+    const size_t FLUSH_BYTES = 64 * 1024;
+}
+
+uint64_t InputLog::fnv1a(const void* data, size_t bytes, uint64_t hash)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Recorder
+
+InputLog::Recorder::~Recorder()
+{
+    if (m_file != nullptr) {
+        flush();
+        fclose(m_file);
+    }
+}
+
+bool InputLog::Recorder::open(const string& path, uint64_t seed)
+{
+    m_file = fopen(path.c_str(), "wb");
+    if (m_file == nullptr) {
+        return false;
+    }
+    m_buffer.reserve(FLUSH_BYTES + 64);
+    m_buffer.insert(m_buffer.end(), MAGIC, MAGIC + 4);
+    putU32(VERSION);
+    putU64(seed);
+    return true;
+}
+
+void InputLog::Recorder::spawn(Vector2f center, int count)
+{
+    putU8(SPAWN);
+    putF32(center.x);
+    putF32(center.y);
+    putU32((uint32_t)count);
+}
+
+void InputLog::Recorder::tick(float dt, double time)
+{
+    putU8(TICK);
+    putF32(dt);
+    putF64(time);
+    // Ticks close every batch of records, so this is the only place to flush
+    if (m_buffer.size() >= FLUSH_BYTES) {
+        flush();
+    }
+}
+
+void InputLog::Recorder::viewport(Vector2u size)
+{
+    putU8(VIEWPORT);
+    putU32(size.x);
+    putU32(size.y);
+}
+
+void InputLog::Recorder::collisions(bool on)
+{
+    putU8(COLLISIONS);
+    putU8(on ? 1 : 0);
+}
+
+void InputLog::Recorder::finish(uint64_t ticks, uint64_t checksum)
+{
+    if (m_file == nullptr) {
+        return;
+    }
+    putU8(END);
+    putU64(ticks);
+    putU64(checksum);
+    flush();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void InputLog::Recorder::putU32(uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) {
+        m_buffer.push_back((uint8_t)(v >> (8 * i)));
+    }
+}
+
+void InputLog::Recorder::putU64(uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) {
+        m_buffer.push_back((uint8_t)(v >> (8 * i)));
+    }
+}
+
+void InputLog::Recorder::putF32(float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    putU32(bits);
+}
+
+void InputLog::Recorder::putF64(double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    putU64(bits);
+}
+
+void InputLog::Recorder::flush()
+{
+    if (!m_buffer.empty()) {
+        fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+        m_buffer.clear();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Player
+
+bool InputLog::Player::load(const string& path, string& error)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+    m_data.clear();
+    uint8_t block[4096];
+    size_t got;
+    while ((got = fread(block, 1, sizeof(block), file)) > 0) {
+        m_data.insert(m_data.end(), block, block + got);
+    }
+    fclose(file);
+
+    m_pos = 0;
+    uint32_t version = 0;
+    if (m_data.size() < 4 || memcmp(m_data.data(), MAGIC, 4) != 0) {
+        error = path + " is not an input log";
+        return false;
+    }
+    m_pos = 4;
+    if (!getU32(version) || version != VERSION) {
+        error = path + " has unsupported version " + to_string(version);
+        return false;
+    }
+    if (!getU64(m_seed)) {
+        error = path + " is truncated";
+        return false;
+    }
+    return true;
+}
+
+bool InputLog::Player::next(Record& record)
+{
+    uint8_t type;
+    if (!getU8(type)) {
+        return false;
+    }
+    record.type = (RecordType)type;
+
+    uint32_t a;
+    uint32_t b;
+    uint8_t on;
+    switch (type) {
+    case SPAWN:
+        if (!getF32(record.center.x) || !getF32(record.center.y) || !getU32(a)) {
+            return false;
+        }
+        record.count = (int32_t)a;
+        return true;
+    case TICK:
+        return getF32(record.dt) && getF64(record.time);
+    case VIEWPORT:
+        if (!getU32(a) || !getU32(b)) {
+            return false;
+        }
+        record.viewport = Vector2u(a, b);
+        return true;
+    case COLLISIONS:
+        if (!getU8(on)) {
+            return false;
+        }
+        record.on = on != 0;
+        return true;
+    case END:
+        return getU64(record.ticks) && getU64(record.checksum);
+    default:
+        // Unknown record: the rest of the log cannot be framed
+        return false;
+    }
+}
+
+bool InputLog::Player::getU8(uint8_t& v)
+{
+    if (m_pos + 1 > m_data.size()) {
+        return false;
+    }
+    v = m_data[m_pos++];
+    return true;
+}
+
+bool InputLog::Player::getU32(uint32_t& v)
+{
+    if (m_pos + 4 > m_data.size()) {
+        return false;
+    }
+    v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v |= (uint32_t)m_data[m_pos++] << (8 * i);
+    }
+    return true;
+}
+
+bool InputLog::Player::getU64(uint64_t& v)
+{
+    if (m_pos + 8 > m_data.size()) {
+        return false;
+    }
+    v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v |= (uint64_t)m_data[m_pos++] << (8 * i);
+    }
+    return true;
+}
+
+bool InputLog::Player::getF32(float& v)
+{
+    uint32_t bits;
+    if (!getU32(bits)) {
+        return false;
+    }
+    memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+bool InputLog::Player::getF64(double& v)
+{
+    uint64_t bits;
+    if (!getU64(bits)) {
+        return false;
+    }
+    memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Headless replay
+
+bool InputLog::replayHeadless(const string& path, unsigned threadCount, const string& checkpointPath)
+{
+    Player player;
+    string error;
+    if (!player.load(path, error)) {
+        cerr << "Replay: " << error << endl;
+        return false;
+    }
+
+    Random::setSeed(player.getSeed());
+    Simulation simulation(threadCount);
+    simulation.reseed();
+    if (!checkpointPath.empty() && !simulation.loadCheckpoint(checkpointPath, error)) {
+        cerr << "Replay: " << error << endl;
+        return false;
+    }
+
+    // Only the ticks themselves are timed; feeding records in is negligible
+    typedef chrono::steady_clock ReplayClock;
+    double tickNs = 0.0;
+    double worstTickNs = 0.0;
+    bool ended = false;
+    Record record;
+    while (!ended && player.next(record)) {
+        switch (record.type) {
+        case SPAWN:
+            if (!simulation.requestSpawn(record.center, record.count)) {
+                cerr << "Replay: more spawns in one tick than the input queue holds" << endl;
+                return false;
+            }
+            break;
+        case VIEWPORT:
+            simulation.setViewport(record.viewport);
+            break;
+        case COLLISIONS:
+            simulation.setCollisions(record.on);
+            break;
+        case TICK: {
+            ReplayClock::time_point start = ReplayClock::now();
+            simulation.tick(record.dt);
+            double ns = (double)chrono::duration_cast<chrono::nanoseconds>(ReplayClock::now() - start).count();
+            tickNs += ns;
+            worstTickNs = max(worstTickNs, ns);
+            break;
+        }
+        case END:
+            ended = true;
+            break;
+        }
+    }
+
+    const uint64_t ticks = simulation.getTick();
+    const uint64_t checksum = simulation.checksum();
+    printf("Replayed %llu ticks from %s on %u threads: %.3f ms/tick avg, %.3f ms worst, %zu particles\n",
+           (unsigned long long)ticks, path.c_str(), simulation.getThreadCount(),
+           ticks ? tickNs * 1e-6 / ticks : 0.0, worstTickNs * 1e-6, simulation.getParticleCount());
+
+    if (!ended) {
+        if (player.atEnd()) {
+            printf("No END record (the recording did not finish): checksum %016llx not verified\n",
+                   (unsigned long long)checksum);
+        }
+        else {
+            printf("Corrupt record at byte %zu: replay stopped early\n", player.getPosition());
+        }
+        return false;
+    }
+    if (record.ticks != ticks || record.checksum != checksum) {
+        printf("MISMATCH: recorded %llu ticks, checksum %016llx; replay got %016llx\n",
+               (unsigned long long)record.ticks, (unsigned long long)record.checksum,
+               (unsigned long long)checksum);
+        return false;
+    }
+    printf("Checksum %016llx matches\n", (unsigned long long)checksum);
+    return true;
+}
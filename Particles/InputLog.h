@@ -0,0 +1,129 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace sf;
+using namespace std;
+
+///Compact binary log of everything that drives a Simulation, so a session can
+///be replayed tick for tick, with or without a window.
+///The simulation is deterministic given its seed and, per tick, the spawns it
+///applied, its dt, the viewport (culling retires particles) and whether
+///collisions were on; that is all the log holds.  A replay feeds the records
+///back through requestSpawn / setViewport / setCollisions / tick and compares
+///the final state's checksum with the one the recording ended on.  Checksums
+///only match between builds with the same Real type and floating-point flags.
+///
+///Layout, little-endian:
+///    "PLOG", u32 version, u64 seed
+///    then records, each a u8 type and its payload:
+///    SPAWN       f32 x, f32 y, i32 count     (applied by the next TICK)
+///    TICK        f32 dt, f64 time            (time: seconds since the start)
+///    VIEWPORT    u32 width, u32 height       (applies from the next TICK on)
+///    COLLISIONS  u8 on                       (applies from the next TICK on)
+///    END         u64 ticks, u64 checksum
+namespace InputLog
+{
+    const uint32_t VERSION = 1;
+
+    enum RecordType : uint8_t
+    {
+        SPAWN = 1,
+        TICK = 2,
+        VIEWPORT = 3,
+        COLLISIONS = 4,
+        END = 0xFF
+    };
+
+    ///One record; only the fields of its type are set
+    struct Record
+    {
+        RecordType type;
+        Vector2f center;
+        int32_t count;
+        float dt;
+        double time;
+        Vector2u viewport;
+        bool on;
+        uint64_t ticks;
+        uint64_t checksum;
+    };
+
+    ///64-bit FNV-1a, chainable through hash
+    const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    uint64_t fnv1a(const void* data, size_t bytes, uint64_t hash = FNV_OFFSET);
+
+    ///Writes a log.  Records are buffered and written in blocks, so recording
+    ///costs the simulation thread a few bytes of copying per event.
+    class Recorder
+    {
+    public:
+        Recorder() = default;
+        ~Recorder();
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        ///Create path and write the header; false if it cannot be opened
+        bool open(const string& path, uint64_t seed);
+        bool isOpen() const { return m_file != nullptr; }
+
+        void spawn(Vector2f center, int count);
+        void tick(float dt, double time);
+        void viewport(Vector2u size);
+        void collisions(bool on);
+
+        ///Write END and close.  Without it the log still replays, unverified.
+        void finish(uint64_t ticks, uint64_t checksum);
+
+    private:
+        FILE* m_file = nullptr;
+        vector<uint8_t> m_buffer;
+
+        void putU8(uint8_t v) { m_buffer.push_back(v); }
+        void putU32(uint32_t v);
+        void putU64(uint64_t v);
+        void putF32(float v);
+        void putF64(double v);
+        void flush();
+    };
+
+    ///Reads a whole log into memory and hands out its records in order
+    class Player
+    {
+    public:
+        ///Read and check the header; on failure error says why
+        bool load(const string& path, string& error);
+
+        uint64_t getSeed() const { return m_seed; }
+
+        ///The next record, false at the end of the log or at a record that
+        ///cannot be read
+        bool next(Record& record);
+
+        ///Every byte of the log has been read
+        bool atEnd() const { return m_pos == m_data.size(); }
+        size_t getPosition() const { return m_pos; }
+
+    private:
+        vector<uint8_t> m_data;
+        size_t m_pos = 0;
+        uint64_t m_seed = 0;
+
+        bool getU8(uint8_t& v);
+        bool getU32(uint32_t& v);
+        bool getU64(uint64_t& v);
+        bool getF32(float& v);
+        bool getF64(double& v);
+    };
+
+    ///Replay path without a window as fast as it will go and report the time
+    ///per tick and whether the final checksum matches.  threadCount sizes the
+    ///simulation's pool (0 = one per hardware thread).  A log recorded after a
+    ///restore needs the same checkpoint, named by checkpointPath.  Returns true
+    ///on a match.
+    bool replayHeadless(const string& path, unsigned threadCount, const string& checkpointPath = "");
+}
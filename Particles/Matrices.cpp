@@ -1,4 +1,6 @@
 #include "Matrices.h"
+#include "AllocStats.h"
+#include "Gemm.h"
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
@@ -15,14 +17,14 @@ bool almostEqual(double a, double b, double eps = 0.0001)
 }
 
 // Base Matrix Constructor
-Matrix::Matrix(int _rows, int _cols) : rows(_rows), cols(_cols)
+Matrix::Matrix(int _rows, int _cols)
+    : rows(_rows), cols(_cols)
 {
-    // Resize the outer vector (rows)
-    a.resize(rows);
-    // Resize each inner vector (columns) and initialize elements to 0.0
-    for (int i = 0; i < rows; ++i) {
-        a[i].resize(cols, 0.0);
-    }
+    // One zero-initialized allocation for the whole matrix instead of one per
+    // row, made here rather than in the initializer list so it is charged to
+    // the matrices
+    ALLOC_SCOPE(AllocStats::MATRICES);
+    a.assign(static_cast<size_t>(_rows) * _cols, 0.0);
 }
 
 // Operator Overload for Matrix Addition: c = a + b
@@ -32,11 +34,14 @@ Matrix Matrices::operator+(const Matrix& a, const Matrix& b)
         throw std::runtime_error("Error: Matrix addition requires matrices of the same dimensions.");
     }
 
+    // Both operands share the same layout, so add the buffers element by element
     Matrix result(a.getRows(), a.getCols());
-    for (int i = 0; i < a.getRows(); ++i) {
-        for (int j = 0; j < a.getCols(); ++j) {
-            result(i, j) = a(i, j) + b(i, j);
-        }
+    const Real* pa = a.data();
+    const Real* pb = b.data();
+    Real* pc = result.data();
+    const int n = a.size();
+    for (int k = 0; k < n; ++k) {
+        pc[k] = pa[k] + pb[k];
     }
     return result;
 }
@@ -49,18 +54,36 @@ Matrix Matrices::operator*(const Matrix& a, const Matrix& b)
     }
 
     Matrix result(a.getRows(), b.getCols());
-    for (int i = 0; i < a.getRows(); ++i) {
-        for (int j = 0; j < b.getCols(); ++j) {
-            double sum = 0.0;
-            for (int k = 0; k < a.getCols(); ++k) {
-                sum += a(i, k) * b(k, j);
-            }
-            result(i, j) = sum;
-        }
-    }
+    multiply(a, b, result);
     return result;
 }
 
+// Matrix multiplication into an existing matrix: out = a * b
+void Matrices::multiply(const Matrix& a, const Matrix& b, Matrix& out, ThreadPool* pool)
+{
+    if (a.getCols() != b.getRows()) {
+        throw std::runtime_error("Error: Matrix multiplication requires matrix A's columns to equal matrix B's rows.");
+    }
+    if (out.getRows() != a.getRows() || out.getCols() != b.getCols()) {
+        throw std::runtime_error("Error: Matrix multiplication output must have A's rows and B's columns.");
+    }
+
+    // The 2x2 kernel reads a up front and each column of b before writing
+    // it, so R * A can go straight back into A
+    if (a.getRows() == 2 && a.getCols() == 2) {
+        Gemm::multiply2x2(a.data(), b.data(), out.data(), b.getCols());
+        return;
+    }
+    // Anything else writing over an operand needs the product somewhere else first
+    if (&out == &a || &out == &b) {
+        Matrix result(a.getRows(), b.getCols());
+        Gemm::multiply(a.data(), b.data(), result.data(), a.getRows(), a.getCols(), b.getCols(), pool);
+        out = result;
+        return;
+    }
+    Gemm::multiply(a.data(), b.data(), out.data(), a.getRows(), a.getCols(), b.getCols(), pool);
+}
+
 // Operator Overload for Matrix Equality: a == b
 bool Matrices::operator==(const Matrix& a, const Matrix& b)
 {
@@ -69,12 +92,13 @@ bool Matrices::operator==(const Matrix& a, const Matrix& b)
         return false;
     }
 
-    // Check elements using an almost equal comparison for doubles
-    for (int i = 0; i < a.getRows(); ++i) {
-        for (int j = 0; j < a.getCols(); ++j) {
-            if (!almostEqual(a(i, j), b(i, j))) {
-                return false;
-            }
+    // Check elements using an almost equal comparison for floating point values
+    const Real* pa = a.data();
+    const Real* pb = b.data();
+    const int n = a.size();
+    for (int k = 0; k < n; ++k) {
+        if (!almostEqual(pa[k], pb[k])) {
+            return false;
         }
     }
     return true;
@@ -106,19 +130,21 @@ std::ostream& Matrices::operator<<(std::ostream& os, const Matrix& a)
 // RotationMatrix Constructor (2x2)
 RotationMatrix::RotationMatrix(double theta) : Matrix(2, 2)
 {
-    a[0][0] = std::cos(theta);
-    a[0][1] = -std::sin(theta);
-    a[1][0] = std::sin(theta);
-    a[1][1] = std::cos(theta);
+    const double c = std::cos(theta);
+    const double s = std::sin(theta);
+    (*this)(0, 0) = c;
+    (*this)(0, 1) = -s;
+    (*this)(1, 0) = s;
+    (*this)(1, 1) = c;
 }
 
 // ScalingMatrix Constructor (2x2)
 ScalingMatrix::ScalingMatrix(double scale) : Matrix(2, 2)
 {
-    a[0][0] = scale;
-    a[0][1] = 0.0;
-    a[1][0] = 0.0;
-    a[1][1] = scale;
+    (*this)(0, 0) = scale;
+    (*this)(0, 1) = 0.0;
+    (*this)(1, 0) = 0.0;
+    (*this)(1, 1) = scale;
 }
 
 // TranslationMatrix Constructor (2 x nCols)
@@ -126,8 +152,9 @@ TranslationMatrix::TranslationMatrix(double xShift, double yShift, int nCols)
     : Matrix(2, nCols)
 {
     // Row 0 = xShift, Row 1 = yShift for all columns
+    // Columns are stored as interleaved (x,y) pairs
     for (int j = 0; j < nCols; ++j) {
-        a[0][j] = xShift;
-        a[1][j] = yShift;
+        a[2 * j] = xShift;
+        a[2 * j + 1] = yShift;
     }
 }
\ No newline at end of file
@@ -5,8 +5,12 @@
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include <stdexcept>
+#include "Precision.h"
 using namespace std;
 
+class ThreadPool;
+
 namespace Matrices
 {
     class Matrix
@@ -18,30 +22,56 @@ namespace Matrices
 
            
             ///inline accessors / mutators, these are done:
+            ///Storage is one contiguous column-major buffer, so element (i,j)
+            ///lives at a[j * rows + i].  For the 2xN coordinate matrices this
+            ///packs each column as an interleaved (x,y) pair.
+            ///Accessors are unchecked unless MATRICES_DEBUG is defined.
 
             ///Read element at row i, column j
-            ///usage:  double x = a(i,j);
-            const double& operator()(int i, int j) const
+            ///usage:  Real x = a(i,j);
+            const Real& operator()(int i, int j) const
             {
-                return a.at(i).at(j);
+                checkIndex(i, j);
+                return a[j * rows + i];
             }
 
             ///Assign element at row i, column j
             ///usage:  a(i,j) = x;
-            double& operator()(int i, int j)
+            Real& operator()(int i, int j)
             {
-                return a.at(i).at(j);
+                checkIndex(i, j);
+                return a[j * rows + i];
             }
 
             int getRows() const{return rows;}
             int getCols() const{return cols;}
+
+            ///Raw access to the column-major buffer (rows * cols elements)
+            Real* data() {return a.data();}
+            const Real* data() const {return a.data();}
+            int size() const{return rows * cols;}
             ///************************************
         protected:
             ///changed to protected so sublasses can modify
-            vector<vector<double>> a;
+            ///elements are Real: double, or float in a PARTICLES_FLOAT32 build
+            vector<Real> a;
         private:
             int rows;
             int cols;
+
+            ///Bounds check used by the accessors in debug builds only
+            void checkIndex(int i, int j) const
+            {
+#ifdef MATRICES_DEBUG
+                if (i < 0 || i >= rows || j < 0 || j >= cols)
+                {
+                    throw out_of_range("Matrix index out of range");
+                }
+#else
+                (void)i;
+                (void)j;
+#endif
+            }
     };
 
     ///Add each corresponding element.
@@ -52,6 +82,13 @@ namespace Matrices
     
     Matrix operator*(const Matrix& a, const Matrix& b);
 
+    ///Matrix multiply into a matrix you already have, so a product in a
+    ///loop allocates nothing:  multiply(a, b, c);  // c = a * b
+    ///out must be a.getRows() x b.getCols(); it may be a or b.  A 2x2 a
+    ///(the transforms on a 2xN coordinate matrix) takes a dedicated kernel,
+    ///large products a cache-blocked SIMD one, spread over pool when given.
+    void multiply(const Matrix& a, const Matrix& b, Matrix& out, ThreadPool* pool = nullptr);
+
     ///Matrix comparison.  
     ///usage:  a == b
     bool operator==(const Matrix& a, const Matrix& b);
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+using namespace std;
+
+///Bounded lock-free queue: any number of threads push, one thread pops.
+///A ring of cells, each with a sequence number that says whose turn it is:
+///a producer claims the next write position with one compare-exchange, fills
+///the cell and publishes it by bumping the sequence; the consumer takes cells
+///in order as they are published.  Nobody ever waits on a lock, and a full
+///queue makes push fail instead of blocking the producer.
+///The storage is allocated once, in the constructor.
+template <typename T>
+class MpscQueue
+{
+public:
+    ///capacity is rounded up to a power of two
+    explicit MpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ///Any thread: append value; false if the queue is full
+    bool push(const T& value)
+    {
+        size_t position = m_enqueue.load(memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[position & m_mask];
+            const size_t sequence = cell->sequence.load(memory_order_acquire);
+            const intptr_t lag = (intptr_t)sequence - (intptr_t)position;
+            if (lag == 0) {
+                // The cell is free for this position: claim it
+                if (m_enqueue.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (lag < 0) {
+                // The consumer has not taken this cell's last value yet
+                return false;
+            }
+            else {
+                // Another producer claimed it first
+                position = m_enqueue.load(memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    ///Consumer only: take the oldest value; false if there is none (or the
+    ///oldest is still being written, in which case the next pop gets it)
+    bool pop(T& value)
+    {
+        Cell& cell = m_cells[m_dequeue & m_mask];
+        if (cell.sequence.load(memory_order_acquire) != m_dequeue + 1) {
+            return false;
+        }
+        value = cell.value;
+        // Free the cell for the producer that comes round to it next lap
+        cell.sequence.store(m_dequeue + m_mask + 1, memory_order_release);
+        ++m_dequeue;
+        return true;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell
+    {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+
+    //producers and the consumer each get a cache line of their own
+    alignas(64) atomic<size_t> m_enqueue{0};
+    alignas(64) size_t m_dequeue = 0;
+};
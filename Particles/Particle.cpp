@@ -1,13 +1,17 @@
 #include "Particle.h"
 #include "Matrices.h" // For Matrix, RotationMatrix, etc.
+#include "FixedMatrix.h" // For the fused rotate/scale/translate expressions
+#include "VertexKernels.h" // For the fused rotate/scale/translate pass
 #include <cmath> // For cos, sin, PI
-#include <cstdlib> // For rand(), RAND_MAX
+#include "Random.h" // For the per-thread Rng
+#include "Profiler.h" // For PROFILE_SCOPE
+#include "AllocStats.h" // For ALLOC_SCOPE
 #include <iostream>
 using namespace sf;
 using namespace std;
 
 
-Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosition)
+Particle::Particle(const CartesianView& view, int numPoints, Vector2i mouseClickPosition)
 // The Matrix member variable m_A must be constructed in an initialization list
     : m_A(2, numPoints) 
 {
@@ -17,27 +21,23 @@ Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosit
 
     // Angular Velocity: m_radiansPerSec
     // Random angular velocity in the range [0:PI] 
-    m_radiansPerSec = ((float)rand() / RAND_MAX) * M_PI; 
+    Rng& rng = Random::threadRng();
+    m_radiansPerSec = rng.uniform(0.0f, (float)M_PI); 
 
-        // 2. Setup the Cartesian Plane View
-        // m_cartesianPlane maps monitor pixels (centered at (W/2, H/2)) to Cartesian (centered at (0,0)) 
-        m_cartesianPlane.setCenter(0.0f, 0.0f); 
-        // Invert the y-axis to match standard Cartesian coordinates 
-        m_cartesianPlane.setSize(target.getSize().x, (-1.0f) * target.getSize().y); 
-
-        // 3. Center Coordinate Initialization
+        // 2. Center Coordinate Initialization
+        // The shared Cartesian view maps monitor pixels (centered at (W/2, H/2)) to Cartesian (centered at (0,0)) 
         // Map mouseClickPosition from pixel coordinates to Cartesian coordinates and store it 
-        m_centerCoordinate = target.mapPixelToCoords(mouseClickPosition, m_cartesianPlane);
+        m_centerCoordinate = view.pixelToCoords(mouseClickPosition);
 
         // 4. Initial Velocities (m_vx, m_vy)
         // Assign m_vx and m_vy to random pixel velocities, e.g., between 100 and 500 
         
-        float initialSpeed = (float)rand() / RAND_MAX * (500.0f - 100.0f) + 100.0f;
+        float initialSpeed = rng.uniform(100.0f, 500.0f);
     m_vx = initialSpeed;
     m_vy = initialSpeed;
 
     // Randomize direction for m_vx (positive or negative) 
-    if (rand() % 2 != 0) {
+    if (rng.coin()) {
         m_vx *= -1.0f;
     }
 
@@ -46,13 +46,13 @@ Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosit
     m_color1 = sf::Color::White; // m_color1 white 
 
     // Generate a random color for m_color2 
-    m_color2 = sf::Color(rand() % 256, rand() % 256, rand() % 256);
+    rng.fillColors(&m_color2, 1);
 
     // 6. Generate Vertices (The Randomized Shape)
     // The algorithm sweeps a circular arc with randomized radii 
 
     // Initialize theta to an angle between [0: PI/2]
-    double theta = ((float)rand() / RAND_MAX) * (M_PI / 2.0);
+    double theta = rng.uniform(0.0, M_PI / 2.0);
 
     // Initialize dTheta to 2*PI / (numPoints - 1) 
     // We divide by numPoints - 1 so the last vertex overlaps with the first 
@@ -63,7 +63,7 @@ Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosit
         double r, dx, dy; // Declare local variables r, dx, and dy 
 
         // Assign a random number between [20:80] to r 
-        r = (double)rand() / RAND_MAX * (80.0 - 20.0) + 20.0;
+        r = rng.uniform(20.0, 80.0);
 
         // Calculate dx and dy 
         dx = r * std::cos(theta); 
@@ -80,19 +80,27 @@ Particle::Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosit
 }
 
 void Particle::draw(RenderTarget& target, RenderStates states) const {
+    PROFILE_SCOPE("particle_draw");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
   
     // Construct a VertexArray named lines of primitive type TriangleFan 
     // numPoints + 1 to account for the center 
     VertexArray lines(TriangleFan, m_numPoints + 1);
+    buildVertices(lines);
+
+    // Draw the VertexArray 
+    target.draw(lines, states); 
+}
 
-    // Declare a local Vector2f named center
-    Vector2f center;
+void Particle::buildVertices(VertexArray& lines) const {
+    lines.setPrimitiveType(TriangleFan);
+    lines.resize(m_numPoints + 1);
 
-    // Assign center by mapping m_centerCoordinate from Cartesian to pixel coordinates 
-    center = (Vector2f)target.mapCoordsToPixel(m_centerCoordinate, m_cartesianPlane); 
+    // Vertices stay in Cartesian coordinates; the caller's states.transform
+    // (CartesianView::getTransform) maps them to pixels on the GPU
 
         // Assign center vertex properties
-        lines[0].position = center; 
+        lines[0].position = m_centerCoordinate; 
         lines[0].color = m_color1; // Center color 
 
     // Loop j from 1 up to and including m_numPoints for the outer vertices 
@@ -102,30 +110,23 @@ void Particle::draw(RenderTarget& target, RenderStates states) const {
         // Get the Cartesian coordinate from m_A (column j - 1)
         Vector2f cartesianCoord(m_A(0, j - 1), m_A(1, j - 1));
 
-        // Assign lines[j].position by mapping Cartesian to pixel coordinates 
-        lines[j].position = (Vector2f)target.mapCoordsToPixel(cartesianCoord, m_cartesianPlane); 
+        // Assign lines[j].position with the Cartesian coordinate 
+        lines[j].position = cartesianCoord; 
 
             // Assign lines[j].color with m_Color2 
             lines[j].color = m_color2;
     }
-
-    // Draw the VertexArray 
-    target.draw(lines, states); 
 }
 void Particle::update(float dt) {
+    PROFILE_SCOPE("particle_update");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
   
     // Subtract dt from m_ttl 
     m_ttl -= dt;
 
-    // 1. Rotation
-    // Call rotate with an angle of dt * m_radiansPerSec 
-    rotate(dt * m_radiansPerSec);
-
-    // 2. Scaling
-    // Call scale using the global constant SCALE (e.g., 0.999)
-    scale(SCALE);
-
-    // 3. Translation (Physics/Movement)
+    // Rotate by dt * m_radiansPerSec, scale by SCALE (both about the center),
+    // then translate by (dx, dy).  The three steps are applied to m_A in a single
+    // pass by the batched vertex kernel instead of through temporary matrices.
     float dx, dy; // Declare local float variables dx and dy
 
     // dx = m_vx * dt 
@@ -138,16 +139,19 @@ void Particle::update(float dt) {
     // dy = m_vy * dt 
     dy = m_vy * dt;
 
-    // Call translate using dx, dy as arguments
-    translate(dx, dy);
+    VertexKernels::ParticleTransform t = VertexKernels::makeTransform(
+        m_centerCoordinate.x, m_centerCoordinate.y, dt * m_radiansPerSec, SCALE, dx, dy);
+    VertexKernels::transformVertices(m_A.data(), m_A.data(), m_numPoints, t);
+
+    // Update the particle's center coordinate 
+    m_centerCoordinate.x += dx;
+    m_centerCoordinate.y += dy;
 }
 
 void Particle::translate(double xShift, double yShift) {
 
-    // Construct a TranslationMatrix T 
-    TranslationMatrix T(xShift, yShift, m_numPoints);
-
-    m_A = T + m_A; 
+    // m_A = T + m_A, with T a broadcast translation instead of a 2xN matrix
+    assign(m_A, translation((Real)xShift, (Real)yShift) + columns(m_A));
 
     // Update the particle's center coordinate 
     m_centerCoordinate.x += xShift; 
@@ -156,40 +160,20 @@ void Particle::translate(double xShift, double yShift) {
 
 void Particle::rotate(double theta) {
     
-    // 1. Store center and shift to origin
-    Vector2f temp = m_centerCoordinate; 
-        // Shift our particle's center back to the origin 
-        translate(-m_centerCoordinate.x, -m_centerCoordinate.y);
-
-    // 2. Rotate
-    // Construct a Rotation Matrix R
-    RotationMatrix R(theta);
-
-    // Multiply it by m_A as m_A = R * m_A (Left-multiply R)
-    m_A = R * m_A; // Assuming Matrix class overloads the multiplication operator '*'
-
-    // 3. Shift back
-    // Shift our particle back to its original center 
-    translate(temp.x, temp.y);
+    // Shift the center to the origin, rotate, and shift back:
+    // m_A = C + R * (m_A - C) in one pass over the columns, with no temporaries
+    Real cx = m_centerCoordinate.x;
+    Real cy = m_centerCoordinate.y;
+    assign(m_A, translation(cx, cy) + rotation((Real)theta) * (columns(m_A) + translation(-cx, -cy)));
 }
 
 void Particle::scale(double c) {
    
-    // 1. Store center and shift to origin
-    Vector2f temp = m_centerCoordinate; 
-        // Shift our particle's center back to the origin 
-        translate(-m_centerCoordinate.x, -m_centerCoordinate.y);
-
-    // 2. Scale
-    // Construct a ScalingMatrix S 
-    ScalingMatrix S(c);
-
-    // Multiply it by m_A as m_A = S * m_A 
-    m_A = S * m_A; // Assuming Matrix class overloads the multiplication operator '*'
-
-    // 3. Shift back
-    // Shift our particle back to its original center 
-    translate(temp.x, temp.y);
+    // Shift the center to the origin, scale, and shift back:
+    // m_A = C + S * (m_A - C) in one pass over the columns, with no temporaries
+    Real cx = m_centerCoordinate.x;
+    Real cy = m_centerCoordinate.y;
+    assign(m_A, translation(cx, cy) + scaling((Real)c) * (columns(m_A) + translation(-cx, -cy)));
 }
 bool Particle::almostEqual(double a, double b, double eps)
 {
@@ -1,5 +1,6 @@
 #pragma once
 #include "Matrices.h"
+#include "CartesianView.h"
 #include <SFML/Graphics.hpp>
 
 #define M_PI 3.1415926535897932384626433
@@ -12,8 +13,11 @@ using namespace sf;
 class Particle : public Drawable
 {
 public:
-	Particle(RenderTarget& target, int numPoints, Vector2i mouseClickPosition);
+	Particle(const CartesianView& view, int numPoints, Vector2i mouseClickPosition);
+	///Draws in Cartesian coordinates; pass the CartesianView's transform in states
 	virtual void draw(RenderTarget& target, RenderStates states) const override;
+    ///Fill lines with the TriangleFan draw submits (center + m_numPoints vertices)
+    void buildVertices(VertexArray& lines) const;
     void update(float dt);
     float getTTL() { return m_ttl; }
 
@@ -28,7 +32,6 @@ private:
     float m_radiansPerSec;
     float m_vx;
     float m_vy;
-    View m_cartesianPlane;
     Color m_color1;
     Color m_color2;
     Matrix m_A;
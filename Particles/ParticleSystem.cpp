@@ -0,0 +1,683 @@
+#include "ParticleSystem.h"
+#include "AllocStats.h"
+#include "Checkpoint.h"
+#include "InputLog.h" // For fnv1a
+#include "Profiler.h"
+#include <algorithm> // For min, max
+#include <cmath> // For pow
+#include <stdexcept> // For runtime_error
+using namespace sf;
+using namespace std;
+
+namespace
+{
+    ///What cull() found for one particle
+    enum Visibility : uint8_t
+    {
+        VISIBLE,
+        HIDDEN,     //off screen, but may still come back
+        GONE        //off screen for the rest of its life
+    };
+}
+
+ParticleSystem::ParticleSystem(const ShapeLibrary& library) : m_library(&library)
+{
+}
+
+void ParticleSystem::spawn(Vector2f center, const int* numPoints, size_t count, Rng& rng)
+{
+    if (count == 0) {
+        return;
+    }
+    PROFILE_SCOPE("spawn");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+
+    const size_t first = m_id.size();
+    const size_t last = first + count;
+
+    // Per particle random values, drawn one array at a time:
+    // angular velocity in [0:PI], speed in [100:500] with a random horizontal direction
+    m_radiansPerSec.resize(last);
+    rng.fillUniform(&m_radiansPerSec[first], count, (Real)0, (Real)M_PI);
+    m_vx.resize(last);
+    m_baseVy.resize(last);
+    rng.fillUniform(&m_baseVy[first], count, (Real)100, (Real)500);
+    float* signs = m_frameArena.allocate<float>(count);
+    rng.fillSigns(signs, count);
+    for (size_t k = 0; k < count; ++k) {
+        m_vx[first + k] = signs[k] * m_baseVy[first + k];
+    }
+    m_color1.resize(last, Color::White);
+    m_color2.resize(last);
+    rng.fillColors(&m_color2[first], count);
+
+    // Start angle in [0:PI/2], and which of the library's shapes to wear
+    m_baseAngle.resize(last);
+    rng.fillUniform(&m_baseAngle[first], count, (Real)0, (Real)(M_PI / 2.0));
+    int* variant = m_frameArena.allocate<int>(count);
+    rng.fillRange(variant, count, 0, m_library->getVariants() - 1);
+
+    m_id.resize(last);
+    m_baseStep.resize(last, m_step);
+    m_baseX.resize(last, center.x);
+    m_baseY.resize(last, center.y);
+    m_baseScale.resize(last, (Real)1);
+    m_shape.resize(last);
+    m_vertexCount.resize(last);
+    m_retired.resize(last, 0);
+    m_visibility.resize(last, VISIBLE);
+    m_pointsBefore.resize(last);
+    for (size_t k = 0; k < count; ++k) {
+        const int n = min(max(numPoints[k], m_library->getMinPoints()), m_library->getMaxPoints());
+        const size_t i = first + k;
+        m_id[i] = m_nextId++;
+        m_shape[i] = m_library->shape(n, variant[k]);
+        m_vertexCount[i] = (uint32_t)n;
+        m_pointsBefore[i] = m_totalPoints;
+        m_totalPoints += (uint32_t)n;
+    }
+
+    // Join this frame's cohort, or open a new one
+    if (m_cohorts.size() > m_firstCohort && m_cohorts.back().spawnTime == m_clock) {
+        m_cohorts.back().end = m_id.size();
+    }
+    else {
+        m_cohorts.push_back({ m_clock, m_id.size() });
+    }
+    m_drawListValid = false;
+}
+
+void ParticleSystem::reserve(size_t count)
+{
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+    m_id.reserve(count);
+    m_baseStep.reserve(count);
+    m_baseX.reserve(count);
+    m_baseY.reserve(count);
+    m_vx.reserve(count);
+    m_baseVy.reserve(count);
+    m_baseAngle.reserve(count);
+    m_baseScale.reserve(count);
+    m_radiansPerSec.reserve(count);
+    m_color1.reserve(count);
+    m_color2.reserve(count);
+    m_shape.reserve(count);
+    m_vertexCount.reserve(count);
+    m_retired.reserve(count);
+    m_visibility.reserve(count);
+    m_pointsBefore.reserve(count);
+    m_drawList.reserve(count);
+    m_drawStart.reserve(count);
+}
+
+void ParticleSystem::removeExpired()
+{
+    PROFILE_SCOPE("removeExpired");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+
+    // Cohorts expire oldest first; retiring one moves m_head past it, taking
+    // any particles cull already retired out of the retired count
+    while (m_firstCohort < m_cohorts.size()
+           && TTL - (m_clock - m_cohorts[m_firstCohort].spawnTime) <= 0.0) {
+        const size_t end = m_cohorts[m_firstCohort].end;
+        for (size_t i = m_head; i < end && m_retiredCount > 0; ++i) {
+            if (m_retired[i]) {
+                --m_retiredCount;
+                m_retiredPoints -= m_vertexCount[i];
+            }
+        }
+        m_head = end;
+        ++m_firstCohort;
+        m_drawListValid = false;
+    }
+
+    // Each reclaim moves at most as many particles as were dropped since the
+    // last one, so the cost stays O(1) amortized per dead particle
+    if (sparse()) {
+        reclaim();
+    }
+}
+
+///Keep the elements of v from head on that are not retired, in order, at the front
+template <typename T>
+static void compact(vector<T>& v, size_t head, const vector<uint8_t>& retired)
+{
+    size_t kept = 0;
+    for (size_t i = head; i < v.size(); ++i) {
+        if (!retired[i]) {
+            v[kept++] = v[i];
+        }
+    }
+    v.resize(kept);
+}
+
+void ParticleSystem::reclaim()
+{
+    // A live cohort's new end is the number of particles kept before its old one
+    size_t c = m_firstCohort;
+    size_t kept = 0;
+    for (size_t i = m_head; i < m_id.size(); ++i) {
+        while (c < m_cohorts.size() && m_cohorts[c].end == i) {
+            m_cohorts[c++].end = kept;
+        }
+        if (!m_retired[i]) {
+            ++kept;
+        }
+    }
+    while (c < m_cohorts.size()) {
+        m_cohorts[c++].end = kept;
+    }
+    m_cohorts.erase(m_cohorts.begin(), m_cohorts.begin() + m_firstCohort);
+
+    compact(m_id, m_head, m_retired);
+    compact(m_baseStep, m_head, m_retired);
+    compact(m_baseX, m_head, m_retired);
+    compact(m_baseY, m_head, m_retired);
+    compact(m_vx, m_head, m_retired);
+    compact(m_baseVy, m_head, m_retired);
+    compact(m_baseAngle, m_head, m_retired);
+    compact(m_baseScale, m_head, m_retired);
+    compact(m_radiansPerSec, m_head, m_retired);
+    compact(m_color1, m_head, m_retired);
+    compact(m_color2, m_head, m_retired);
+    compact(m_shape, m_head, m_retired);
+    compact(m_vertexCount, m_head, m_retired);
+    compact(m_visibility, m_head, m_retired);
+    m_retired.assign(kept, 0);
+
+    m_pointsBefore.resize(kept);
+    m_totalPoints = 0;
+    for (size_t i = 0; i < kept; ++i) {
+        m_pointsBefore[i] = m_totalPoints;
+        m_totalPoints += m_vertexCount[i];
+    }
+
+    m_firstCohort = 0;
+    m_head = 0;
+    m_retiredCount = 0;
+    m_retiredPoints = 0;
+    m_drawListValid = false;
+}
+
+void ParticleSystem::update(float dt)
+{
+    PROFILE_SCOPE("system_update");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+
+    // The closed form assumes every step since the base had the same dt, so a
+    // new dt first settles everyone at the current step under the old one
+    if (dt != m_stepDt) {
+        for (size_t i = m_head; i < m_id.size(); ++i) {
+            rebase(i);
+        }
+        m_stepDt = dt;
+    }
+
+    m_clock += dt;
+    ++m_step;
+    m_drawListValid = false;
+
+    // Last frame's temporaries are dead by now
+    m_frameArena.reset();
+}
+
+ParticleSystem::State ParticleSystem::stateAt(size_t i) const
+{
+    const double k = (double)(m_step - m_baseStep[i]);
+    const double h = m_stepDt;
+
+    // k steps of Particle::update: vy drops by G * h before every move
+    State s;
+    s.vx = m_vx[i];
+    s.vy = m_baseVy[i] - G * h * k;
+    s.x = m_baseX[i] + k * h * s.vx;
+    s.y = m_baseY[i] + h * (k * m_baseVy[i] - G * h * k * (k + 1.0) / 2.0);
+    s.angle = m_baseAngle[i] + k * h * m_radiansPerSec[i];
+    s.scale = m_baseScale[i] * std::pow((double)SCALE, k);
+    return s;
+}
+
+void ParticleSystem::rebase(size_t i)
+{
+    State s = stateAt(i);
+    m_baseStep[i] = m_step;
+    m_baseX[i] = (Real)s.x;
+    m_baseY[i] = (Real)s.y;
+    m_baseVy[i] = (Real)s.vy;
+    m_baseAngle[i] = (Real)s.angle;
+    m_baseScale[i] = (Real)s.scale;
+}
+
+void ParticleSystem::collide(ThreadPool& pool)
+{
+    if (!m_collisions) {
+        return;
+    }
+    PROFILE_SCOPE("collide");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+    const size_t head = m_head;
+    const size_t n = m_id.size() - head;
+    if (n < 2) {
+        return;
+    }
+
+    // Particles only shrink, so a cell two spawn-size radii wide holds every
+    // pair that can touch within the 3x3 cells around either one
+    float* x = m_frameArena.allocate<float>(n);
+    float* y = m_frameArena.allocate<float>(n);
+    pool.parallelFor(n, COLLIDE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            State s = stateAt(head + k);
+            x[k] = (float)s.x;
+            y[k] = (float)s.y;
+        }
+    });
+    m_grid.build(x, y, n, (float)(2.0 * MAX_RADIUS), pool);
+
+    // What the narrow phase reads of each particle, packed small and in grid
+    // order: neighbours then sit near each other in memory, and so do the
+    // queries of consecutive slots.  Retired particles get a negative radius.
+    Body* bodies = m_frameArena.allocate<Body>(n);
+    float* dvx = m_frameArena.allocate<float>(n);
+    float* dvy = m_frameArena.allocate<float>(n);
+    pool.parallelFor(n, COLLIDE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            const size_t i = head + m_grid.item(s);
+            const double k = (double)(m_step - m_baseStep[i]);
+            Body& body = bodies[s];
+            body.x = x[m_grid.item(s)];
+            body.y = y[m_grid.item(s)];
+            body.vx = (float)m_vx[i];
+            body.vy = (float)(m_baseVy[i] - G * m_stepDt * k);
+            body.radius = m_retired[i] ? -1.0f : (float)(MAX_RADIUS * m_baseScale[i] * std::pow((double)SCALE, k));
+        }
+    });
+
+    // Each particle adds up its own velocity change from every contact, so
+    // workers only write their own slots and the result is order independent
+    pool.parallelFor(n, COLLIDE_GRAIN, [&](size_t begin, size_t end) {
+        PROFILE_SCOPE("collide_chunk");
+        for (size_t s = begin; s < end; ++s) {
+            const Body a = bodies[s];
+            float ax = 0.0f;
+            float ay = 0.0f;
+            if (a.radius >= 0.0f) {
+                m_grid.forEachNear(a.x, a.y, [&](uint32_t t) {
+                    const Body& b = bodies[t];
+                    const float dx = a.x - b.x;
+                    const float dy = a.y - b.y;
+                    const float reach = a.radius + b.radius;
+                    const float d2 = dx * dx + dy * dy;
+                    // Also skips a itself (d2 == 0) and retired particles (reach < radius)
+                    if (d2 >= reach * reach || d2 < 1e-6f || b.radius < 0.0f) {
+                        return;
+                    }
+
+                    // Swap the velocity components along the line of centers,
+                    // but only for a pair that is still closing in
+                    const float d = std::sqrt(d2);
+                    const float nx = dx / d;
+                    const float ny = dy / d;
+                    const float closing = (a.vx - b.vx) * nx + (a.vy - b.vy) * ny;
+                    if (closing < 0.0f) {
+                        ax -= closing * nx;
+                        ay -= closing * ny;
+                    }
+                });
+            }
+            dvx[s] = ax;
+            dvy[s] = ay;
+        }
+    });
+
+    pool.parallelFor(n, COLLIDE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            if (dvx[s] != 0.0f || dvy[s] != 0.0f) {
+                const size_t i = head + m_grid.item(s);
+                rebase(i);
+                m_vx[i] += dvx[s];
+                m_baseVy[i] += dvy[s];
+            }
+        }
+    });
+    m_drawListValid = false;
+}
+
+void ParticleSystem::cull(const FloatRect& view, ThreadPool& pool)
+{
+    PROFILE_SCOPE("cull");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+    const size_t head = m_head;
+    const size_t n = m_id.size() - head;
+
+    if (view.width > 0.0f && view.height > 0.0f) {
+        const double left = view.left;
+        const double right = (double)view.left + view.width;
+        const double bottom = view.top;
+        const double top = (double)view.top + view.height;
+
+        pool.parallelFor(n, SNAPSHOT_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = head + begin; i < head + end; ++i) {
+                if (m_retired[i]) {
+                    m_visibility[i] = GONE;
+                    continue;
+                }
+                State s = stateAt(i);
+                const double r = MAX_RADIUS * s.scale;
+                const bool below = s.y + r < bottom;
+                const bool leftOf = s.x + r < left;
+                const bool rightOf = s.x - r > right;
+
+                // Without collisions vx never changes and vy only falls, so none
+                // of these can reverse; a particle above the view is only hidden
+                if (!m_collisions && ((below && s.vy <= 0.0) || (leftOf && s.vx <= 0.0) || (rightOf && s.vx >= 0.0))) {
+                    m_visibility[i] = GONE;
+                }
+                else if (below || leftOf || rightOf || s.y - r > top) {
+                    m_visibility[i] = HIDDEN;
+                }
+                else {
+                    m_visibility[i] = VISIBLE;
+                }
+            }
+        });
+
+        for (size_t i = head; i < m_id.size(); ++i) {
+            if (m_visibility[i] == GONE && !m_retired[i]) {
+                m_retired[i] = 1;
+                ++m_retiredCount;
+                m_retiredPoints += m_vertexCount[i];
+            }
+        }
+        if (sparse()) {
+            reclaim();
+        }
+    }
+    else {
+        for (size_t i = head; i < m_id.size(); ++i) {
+            m_visibility[i] = m_retired[i] ? GONE : VISIBLE;
+        }
+    }
+
+    // One serial pass lays out the snapshot: it only adds up ring sizes
+    m_drawList.clear();
+    m_drawStart.clear();
+    m_drawPoints = 0;
+    for (size_t i = m_head; i < m_id.size(); ++i) {
+        if (m_visibility[i] == VISIBLE) {
+            m_drawList.push_back((uint32_t)i);
+            m_drawStart.push_back(m_drawPoints);
+            m_drawPoints += m_vertexCount[i];
+        }
+    }
+    m_drawListValid = true;
+}
+
+void ParticleSystem::snapshot(Snapshot& out, uint64_t tick, double time, ThreadPool& pool) const
+{
+    PROFILE_SCOPE("snapshot");
+    // The snapshot's arrays belong to the renderer
+    ALLOC_SCOPE(AllocStats::RENDER);
+    if (!m_drawListValid) {
+        throw runtime_error("Error: ParticleSystem::snapshot needs a cull() after the last spawn, removeExpired or update.");
+    }
+
+    const size_t n = m_drawList.size();
+    out.tick = tick;
+    out.time = time;
+    out.shapes = m_library->data();
+    out.id.resize(n);
+    out.centerX.resize(n);
+    out.centerY.resize(n);
+    out.angle.resize(n);
+    out.scale.resize(n);
+    out.shape.resize(n);
+    out.color1.resize(n);
+    out.color2.resize(n);
+    out.vertexStart.resize(n + 1);
+    out.vertexStart[n] = m_drawPoints;
+
+    pool.parallelFor(n, SNAPSHOT_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            const size_t i = m_drawList[k];
+            State s = stateAt(i);
+            out.id[k] = m_id[i];
+            out.centerX[k] = (float)s.x;
+            out.centerY[k] = (float)s.y;
+            out.angle[k] = (float)s.angle;
+            out.scale[k] = (float)s.scale;
+            out.shape[k] = m_shape[i];
+            out.color1[k] = m_color1[i];
+            out.color2[k] = m_color2[i];
+            out.vertexStart[k] = m_drawStart[k];
+        }
+    });
+}
+
+uint64_t ParticleSystem::checksum() const
+{
+    uint64_t hash = InputLog::fnv1a(&m_step, sizeof(m_step));
+    for (size_t i = m_head; i < m_id.size(); ++i) {
+        if (m_retired[i]) {
+            continue;
+        }
+        State s = stateAt(i);
+        hash = InputLog::fnv1a(&m_id[i], sizeof(m_id[i]), hash);
+        hash = InputLog::fnv1a(&s, sizeof(s), hash);
+        hash = InputLog::fnv1a(&m_vertexCount[i], sizeof(m_vertexCount[i]), hash);
+        hash = InputLog::fnv1a(&m_color2[i], sizeof(m_color2[i]), hash);
+    }
+    return hash;
+}
+
+namespace
+{
+    //section tags of a particle checkpoint, one per array
+    const char TAG_ID[4] = { 'I', 'D', ' ', ' ' };
+    const char TAG_BASE_STEP[4] = { 'S', 'T', 'E', 'P' };
+    const char TAG_X[4] = { 'X', ' ', ' ', ' ' };
+    const char TAG_Y[4] = { 'Y', ' ', ' ', ' ' };
+    const char TAG_VX[4] = { 'V', 'X', ' ', ' ' };
+    const char TAG_VY[4] = { 'V', 'Y', ' ', ' ' };
+    const char TAG_ANGLE[4] = { 'A', 'N', 'G', 'L' };
+    const char TAG_SCALE[4] = { 'S', 'C', 'A', 'L' };
+    const char TAG_SPIN[4] = { 'S', 'P', 'I', 'N' };
+    const char TAG_COLOR1[4] = { 'C', 'O', 'L', '1' };
+    const char TAG_COLOR2[4] = { 'C', 'O', 'L', '2' };
+    const char TAG_SHAPE[4] = { 'S', 'H', 'A', 'P' };
+    const char TAG_POINTS[4] = { 'N', 'P', 'T', 'S' };
+    const char TAG_COHORTS[4] = { 'C', 'O', 'H', 'O' };
+
+    ///Copy section tag of file into v, which must come out count long
+    template <typename T>
+    bool readSection(const Checkpoint::MappedFile& file, const char tag[4], size_t count, vector<T>& v)
+    {
+        size_t found = 0;
+        const T* data = static_cast<const T*>(file.section(tag, sizeof(T), found));
+        if (data == nullptr || found != count) {
+            return false;
+        }
+        v.assign(data, data + count);
+        return true;
+    }
+}
+
+bool ParticleSystem::saveCheckpoint(const string& path)
+{
+    PROFILE_SCOPE("checkpoint_save");
+    // With the dead slots dropped every array is exactly the live particles,
+    // and each one goes to disk as it is
+    if (m_head > 0 || m_retiredCount > 0) {
+        reclaim();
+    }
+    m_cohorts.erase(m_cohorts.begin(), m_cohorts.begin() + m_firstCohort);
+    m_firstCohort = 0;
+
+    Checkpoint::Header header = {};
+    header.realSize = sizeof(Real);
+    header.particles = m_id.size();
+    header.nextId = m_nextId;
+    header.clock = m_clock;
+    header.step = m_step;
+    header.stepDt = m_stepDt;
+    header.minPoints = m_library->getMinPoints();
+    header.maxPoints = m_library->getMaxPoints();
+    header.variants = m_library->getVariants();
+    header.library = m_library->getChecksum();
+
+    Checkpoint::Writer writer;
+    if (!writer.open(path, header)) {
+        return false;
+    }
+    writer.section(TAG_ID, m_id);
+    writer.section(TAG_BASE_STEP, m_baseStep);
+    writer.section(TAG_X, m_baseX);
+    writer.section(TAG_Y, m_baseY);
+    writer.section(TAG_VX, m_vx);
+    writer.section(TAG_VY, m_baseVy);
+    writer.section(TAG_ANGLE, m_baseAngle);
+    writer.section(TAG_SCALE, m_baseScale);
+    writer.section(TAG_SPIN, m_radiansPerSec);
+    writer.section(TAG_COLOR1, m_color1);
+    writer.section(TAG_COLOR2, m_color2);
+    writer.section(TAG_SHAPE, m_shape);
+    writer.section(TAG_POINTS, m_vertexCount);
+    writer.section(TAG_COHORTS, m_cohorts);
+    return writer.finish();
+}
+
+bool ParticleSystem::loadCheckpoint(const string& path, string& error)
+{
+    PROFILE_SCOPE("checkpoint_load");
+    ALLOC_SCOPE(AllocStats::PARTICLE);
+    Checkpoint::MappedFile file;
+    if (!file.open(path, error)) {
+        return false;
+    }
+    const Checkpoint::Header& header = file.header();
+    if (header.realSize != sizeof(Real)) {
+        error = path + " was saved with " + to_string(header.realSize * 8) + "-bit Reals";
+        return false;
+    }
+    if (header.minPoints != m_library->getMinPoints() || header.maxPoints != m_library->getMaxPoints()
+        || header.variants != m_library->getVariants() || header.library != m_library->getChecksum()) {
+        error = path + " was saved with different particle shapes";
+        return false;
+    }
+
+    // Read into a fresh system so a bad file leaves this one untouched.  Each
+    // array is one copy straight out of the mapping: vectors cannot adopt the
+    // mapped pages, but nothing is parsed or converted on the way.
+    ParticleSystem loaded(*m_library);
+    const size_t n = (size_t)header.particles;
+    size_t cohortCount = 0;
+    const Cohort* cohorts = static_cast<const Cohort*>(file.section(TAG_COHORTS, sizeof(Cohort), cohortCount));
+    if (!readSection(file, TAG_ID, n, loaded.m_id) || !readSection(file, TAG_BASE_STEP, n, loaded.m_baseStep)
+        || !readSection(file, TAG_X, n, loaded.m_baseX) || !readSection(file, TAG_Y, n, loaded.m_baseY)
+        || !readSection(file, TAG_VX, n, loaded.m_vx) || !readSection(file, TAG_VY, n, loaded.m_baseVy)
+        || !readSection(file, TAG_ANGLE, n, loaded.m_baseAngle) || !readSection(file, TAG_SCALE, n, loaded.m_baseScale)
+        || !readSection(file, TAG_SPIN, n, loaded.m_radiansPerSec) || !readSection(file, TAG_COLOR1, n, loaded.m_color1)
+        || !readSection(file, TAG_COLOR2, n, loaded.m_color2) || !readSection(file, TAG_SHAPE, n, loaded.m_shape)
+        || !readSection(file, TAG_POINTS, n, loaded.m_vertexCount) || cohorts == nullptr) {
+        error = path + " is truncated or missing a section";
+        return false;
+    }
+    loaded.m_cohorts.assign(cohorts, cohorts + cohortCount);
+
+    // Everything snapshot and the cohorts index with must be in range
+    size_t previousEnd = 0;
+    for (const Cohort& cohort : loaded.m_cohorts) {
+        if (cohort.end < previousEnd || cohort.end > n) {
+            error = path + " has corrupt cohorts";
+            return false;
+        }
+        previousEnd = cohort.end;
+    }
+    if (previousEnd != n) {
+        error = path + " has corrupt cohorts";
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const int points = (int)loaded.m_vertexCount[i];
+        if (points < m_library->getMinPoints() || points > m_library->getMaxPoints()
+            || (size_t)loaded.m_shape[i] + points > m_library->vertexCount() || loaded.m_baseStep[i] > header.step) {
+            error = path + " has a corrupt particle at index " + to_string(i);
+            return false;
+        }
+    }
+
+    loaded.m_retired.assign(n, 0);
+    loaded.m_visibility.assign(n, VISIBLE);
+    loaded.m_pointsBefore.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        loaded.m_pointsBefore[i] = loaded.m_totalPoints;
+        loaded.m_totalPoints += loaded.m_vertexCount[i];
+    }
+    loaded.m_clock = header.clock;
+    loaded.m_step = header.step;
+    loaded.m_stepDt = header.stepDt;
+    loaded.m_nextId = header.nextId;
+
+    swap(m_id, loaded.m_id);
+    swap(m_baseStep, loaded.m_baseStep);
+    swap(m_baseX, loaded.m_baseX);
+    swap(m_baseY, loaded.m_baseY);
+    swap(m_vx, loaded.m_vx);
+    swap(m_baseVy, loaded.m_baseVy);
+    swap(m_baseAngle, loaded.m_baseAngle);
+    swap(m_baseScale, loaded.m_baseScale);
+    swap(m_radiansPerSec, loaded.m_radiansPerSec);
+    swap(m_color1, loaded.m_color1);
+    swap(m_color2, loaded.m_color2);
+    swap(m_shape, loaded.m_shape);
+    swap(m_vertexCount, loaded.m_vertexCount);
+    swap(m_retired, loaded.m_retired);
+    swap(m_visibility, loaded.m_visibility);
+    swap(m_pointsBefore, loaded.m_pointsBefore);
+    swap(m_cohorts, loaded.m_cohorts);
+    m_totalPoints = loaded.m_totalPoints;
+    m_firstCohort = 0;
+    m_head = 0;
+    m_retiredCount = 0;
+    m_retiredPoints = 0;
+    m_clock = loaded.m_clock;
+    m_step = loaded.m_step;
+    m_stepDt = loaded.m_stepDt;
+    m_nextId = loaded.m_nextId;
+    m_drawList.clear();
+    m_drawStart.clear();
+    m_drawPoints = 0;
+    m_drawListValid = false;
+    return true;
+}
+
+void ParticleSystem::clear()
+{
+    m_id.clear();
+    m_baseStep.clear();
+    m_baseX.clear();
+    m_baseY.clear();
+    m_vx.clear();
+    m_baseVy.clear();
+    m_baseAngle.clear();
+    m_baseScale.clear();
+    m_radiansPerSec.clear();
+    m_color1.clear();
+    m_color2.clear();
+    m_shape.clear();
+    m_vertexCount.clear();
+    m_retired.clear();
+    m_visibility.clear();
+    m_pointsBefore.clear();
+    m_totalPoints = 0;
+    m_retiredCount = 0;
+    m_retiredPoints = 0;
+    m_drawList.clear();
+    m_drawStart.clear();
+    m_drawPoints = 0;
+    m_drawListValid = false;
+    m_frameArena.reset();
+    m_cohorts.clear();
+    m_firstCohort = 0;
+    m_head = 0;
+}
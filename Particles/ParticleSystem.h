@@ -0,0 +1,231 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FrameArena.h"
+#include "Particle.h"
+#include "Precision.h"
+#include "Random.h"
+#include "ShapeLibrary.h"
+#include "Snapshot.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+using namespace sf;
+using namespace std;
+
+///Structure-of-arrays storage for every live particle, kept analytically.
+///A particle does not own vertices.  It stores the state it had at its base
+///step (center, velocity, angle, scale), its angular velocity and a shape from
+///the ShapeLibrary.  Every update step does what Particle::update does with a
+///fixed dt:
+///    vy -= G * dt;  center += (vx, vy) * dt;  angle += w * dt;  scale *= SCALE
+///so after k steps the state has a closed form:
+///    x = x0 + k * dt * vx
+///    y = y0 + dt * (k * vy0 - G * dt * k * (k + 1) / 2)
+///    angle = angle0 + k * dt * w,  scale = scale0 * SCALE^k
+///update is therefore O(1) for the whole system, a particle is O(1) memory
+///whatever its point count, and rounding never accumulates from step to step.
+///Vertices only exist once a snapshot is drawn.  Changing dt rebases every
+///particle to the current step first.
+///
+///Every particle gets a serial id at spawn, so ids increase along the arrays.
+///Every particle lives exactly TTL seconds, so particles expire in spawn order.
+///Particles spawned in the same frame form a cohort; expiry retires whole
+///cohorts from the front of the queue by moving m_head past them.
+///
+///cull() tests every particle's bounding circle against the view.  Only the
+///particles it finds on screen go into snapshots, and particles that can
+///never come back into view are retired there and then: gravity only ever
+///pulls down, so a particle wholly below the view and not rising is gone for
+///good, and so is one wholly off a side and moving away from it.  That only
+///holds for ballistic motion, so nothing is retired while collisions are on.
+///Retired particles are flagged in place until the next reclaim, which drops them
+///together with the expired prefix once the dead outnumber the live.
+///Particles still to be checked are the slots [m_head, m_id.size()).
+///
+///Collisions, when turned on, bounce touching particles off each other.  A
+///collision changes a velocity, which the closed form cannot express, so the
+///particles involved are rebased at the current step first.
+///
+///Once the arrays have grown to the peak particle count, a tick of spawn,
+///removeExpired, update, collide, cull and snapshot does no heap allocation.
+class ParticleSystem
+{
+public:
+    ///State of one particle at the current step
+    struct State
+    {
+        double x;
+        double y;
+        double vx;
+        double vy;
+        double angle;
+        double scale;
+    };
+
+    ///shapes come from library, which must outlive the system
+    explicit ParticleSystem(const ShapeLibrary& library = ShapeLibrary::standard());
+
+    ///Add count particles centered at center (Cartesian coordinates); particle k
+    ///gets numPoints[k] vertices, clamped to the library's range.  Same
+    ///distributions as Particle::Particle, but each random quantity is drawn for
+    ///the whole batch with one rng fill.
+    void spawn(Vector2f center, const int* numPoints, size_t count, Rng& rng);
+    void spawn(Vector2f center, int numPoints, Rng& rng) { spawn(center, &numPoints, 1, rng); }
+
+    ///Grow every per-particle array to hold count particles, so spawning up
+    ///to that many allocates nothing
+    void reserve(size_t count);
+
+    ///Retire every cohort whose TTL has run out.  O(1) per cohort; runs
+    ///serially, before update, so it never races a snapshot.
+    void removeExpired();
+
+    ///Advance every particle by one step of dt.  O(1): only the step counter
+    ///moves, unless dt differs from the previous step's.
+    void update(float dt);
+
+    ///Turn particle-particle collisions on or off (off by default)
+    void setCollisions(bool on) { m_collisions = on; }
+    bool getCollisions() const { return m_collisions; }
+
+    ///Bounce apart every pair of particles whose bounding circles overlap and
+    ///are closing in: an elastic collision between equal masses, resolved for
+    ///every particle at once from the positions at the current step.  Pairs are
+    ///found through a SpatialGrid, so the cost is O(n) for a spread-out crowd.
+    ///Does nothing while collisions are off.  Call after update.
+    void collide(ThreadPool& pool);
+
+    ///Find the particles whose bounding circle (radius MAX_RADIUS * scale)
+    ///overlaps view, in Cartesian coordinates with view.top as the lowest y,
+    ///and retire those that can never overlap it again.  An empty view draws
+    ///every particle and retires none.  Call after the tick's last update.
+    void cull(const FloatRect& view, ThreadPool& pool);
+
+    ///Evaluate the particles the last cull() found on screen into out,
+    ///stamped with tick and time.  out's arrays are resized, never shrunk, so a
+    ///reused snapshot only reallocates when the particle count grows.
+    ///Throws if particles were spawned, expired or moved since that cull.
+    void snapshot(Snapshot& out, uint64_t tick, double time, ThreadPool& pool) const;
+
+    ///Slot k from the oldest unexpired particle at the current step; retired
+    ///particles keep their slot until the next reclaim
+    State state(size_t k) const { return stateAt(m_head + k); }
+
+    ///Live particles: neither expired nor retired by cull
+    size_t size() const { return m_id.size() - m_head - m_retiredCount; }
+    size_t vertexCount() const
+    {
+        return (m_head < m_id.size() ? m_totalPoints - m_pointsBefore[m_head] : 0) - m_retiredPoints;
+    }
+    bool empty() const { return size() == 0; }
+    ///Particles in the last cull's draw list
+    size_t visibleCount() const { return m_drawList.size(); }
+    void clear();
+
+    ///FNV-1a over the step and every live particle's id, state and colors:
+    ///equal checksums mean the same particles in the same places
+    uint64_t checksum() const;
+
+    ///Write every live particle to a Checkpoint file at path; false if it
+    ///cannot be written.  Drops expired and retired slots first.
+    bool saveCheckpoint(const string& path);
+
+    ///Replace every particle with the ones saved at path, which must come from
+    ///a build with the same Real type and a library with the same shapes.  On
+    ///failure error says why and the particles are left as they were.
+    bool loadCheckpoint(const string& path, string& error);
+
+    ///Radius of the largest shape at scale 1; ShapeLibrary radii are below it
+    static constexpr double MAX_RADIUS = 80.0;
+
+private:
+    ///One particle as the collision narrow phase sees it
+    struct Body
+    {
+        float x;
+        float y;
+        float vx;
+        float vy;
+        float radius;
+    };
+
+    ///Particles spawned on the same frame, stored at indices [previous end, end)
+    struct Cohort
+    {
+        double spawnTime;
+        size_t end;
+    };
+
+    const ShapeLibrary* m_library;
+
+    //per particle state; entries before m_head belong to retired cohorts
+    vector<uint64_t> m_id;
+    vector<uint32_t> m_baseStep;    //step the base state below belongs to
+    vector<Real> m_baseX;
+    vector<Real> m_baseY;
+    vector<Real> m_vx;
+    vector<Real> m_baseVy;
+    vector<Real> m_baseAngle;
+    vector<Real> m_baseScale;
+    vector<Real> m_radiansPerSec;
+    vector<Color> m_color1;
+    vector<Color> m_color2;
+    vector<uint32_t> m_shape;       //vertex offset of the shape in m_library
+    vector<uint32_t> m_vertexCount;
+    vector<uint8_t> m_retired;      //1 once cull found the particle can never be seen again
+
+    //ring vertices of every particle stored before i; gives each particle's
+    //place in the snapshot without a prefix sum
+    vector<uint32_t> m_pointsBefore;
+    uint32_t m_totalPoints = 0;
+
+    //cohorts in spawn order; the live ones start at m_firstCohort
+    vector<Cohort> m_cohorts;
+    size_t m_firstCohort = 0;
+    size_t m_head = 0;
+
+    //retired particles (and their ring vertices) at or after m_head
+    size_t m_retiredCount = 0;
+    uint32_t m_retiredPoints = 0;
+
+    //last cull: slots on screen in order, where each one's ring starts in the
+    //snapshot, and whether anything has changed since
+    vector<uint8_t> m_visibility;
+    vector<uint32_t> m_drawList;
+    vector<uint32_t> m_drawStart;
+    uint32_t m_drawPoints = 0;
+    bool m_drawListValid = false;
+
+    //simulation time and steps taken, advanced by update
+    double m_clock = 0.0;
+    uint32_t m_step = 0;
+    //dt of every step since the last rebase
+    float m_stepDt = 0.0f;
+
+    //id of the next particle spawned
+    uint64_t m_nextId = 0;
+
+    //spawn and collide temporaries; reset by update
+    FrameArena m_frameArena;
+
+    bool m_collisions = false;
+    SpatialGrid m_grid;
+
+    ///particles handed to each pool task
+    static const size_t SNAPSHOT_GRAIN = 1024;
+    static const size_t COLLIDE_GRAIN = 512;
+
+    State stateAt(size_t i) const;
+
+    ///Make the current step particle i's base step
+    void rebase(size_t i);
+
+    ///Expired and retired slots outnumber the live particles
+    bool sparse() const { return m_head + m_retiredCount > 0 && m_head + m_retiredCount >= size(); }
+
+    ///Move the live particles down to index 0, dropping expired and retired ones
+    void reclaim();
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+///Scalar type of the simulation math: Matrix storage and the particle vertex rings.
+///double by default.  Build with -DPARTICLES_FLOAT32 (make FLOAT32=1) for float,
+///which halves the vertex memory the update streams through and doubles the
+///vertices per SIMD instruction.  Either way results must stay within the
+///almostEqual tolerance the unit tests use.
+#ifdef PARTICLES_FLOAT32
+typedef float Real;
+#else
+typedef double Real;
+#endif
@@ -0,0 +1,302 @@
+#include "Profiler.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+using namespace Profiler;
+
+namespace
+{
+    typedef chrono::steady_clock ProfileClock;
+
+    ///Fixed-size single-producer single-consumer queue of samples.
+    ///The owning thread pushes; endFrame, on the frame thread, drains.
+    class SampleRing
+    {
+    public:
+        ///power of two, so positions wrap with a mask
+        static const size_t CAPACITY = 4096;
+
+        bool push(const Sample& sample)
+        {
+            const size_t write = m_write.load(memory_order_relaxed);
+            if (write - m_read.load(memory_order_acquire) == CAPACITY) {
+                return false;
+            }
+            m_samples[write & (CAPACITY - 1)] = sample;
+            m_write.store(write + 1, memory_order_release);
+            return true;
+        }
+
+        template <typename Sink>
+        void drain(Sink&& sink)
+        {
+            size_t read = m_read.load(memory_order_relaxed);
+            const size_t write = m_write.load(memory_order_acquire);
+            for (; read != write; ++read) {
+                sink(m_samples[read & (CAPACITY - 1)]);
+            }
+            m_read.store(read, memory_order_release);
+        }
+
+    private:
+        Sample m_samples[CAPACITY];
+        //producer and consumer indices on separate cache lines
+        alignas(64) atomic<size_t> m_write{0};
+        alignas(64) atomic<size_t> m_read{0};
+    };
+
+    ///samples kept for dumps, a power of two (4 MB)
+    const size_t HISTORY_SAMPLES = (size_t)1 << 17;
+
+    ///weight of the newest frame in the HUD averages
+    const double SMOOTHING = 0.1;
+
+    const ProfileClock::time_point g_epoch = ProfileClock::now();
+
+    //shared with every recording thread
+    atomic<bool> g_enabled{true};
+    atomic<uint32_t> g_frame{0};
+    atomic<uint64_t> g_dropped{0};
+    mutex g_registryLock;
+    vector<unique_ptr<SampleRing>> g_rings;
+
+    //frame thread only
+    int g_frameThread = -1;
+    uint64_t g_frameStart = 0;
+    vector<Sample> g_history;
+    uint64_t g_historyCount = 0;
+    uint32_t g_framesRecorded = 0;
+    vector<PhaseTime> g_phases;
+    vector<double> g_phaseThisFrame;
+    double g_frameMs = 0.0;
+
+    thread_local SampleRing* t_ring = nullptr;
+    thread_local uint16_t t_thread = 0;
+    thread_local uint16_t t_depth = 0;
+
+    ///The calling thread's ring, registered on first use
+    SampleRing* threadRing()
+    {
+        if (t_ring == nullptr) {
+            lock_guard<mutex> lock(g_registryLock);
+            g_rings.push_back(unique_ptr<SampleRing>(new SampleRing()));
+            t_ring = g_rings.back().get();
+            t_thread = (uint16_t)(g_rings.size() - 1);
+        }
+        return t_ring;
+    }
+
+    ///Add this frame's time for one top-level scope of the frame thread
+    void accumulatePhase(const char* name, double ms)
+    {
+        for (size_t k = 0; k < g_phases.size(); ++k) {
+            if (g_phases[k].name == name || strcmp(g_phases[k].name, name) == 0) {
+                g_phaseThisFrame[k] += ms;
+                return;
+            }
+        }
+        // First sighting: a negative average means "start at this frame's value"
+        g_phases.push_back({ name, -1.0 });
+        g_phaseThisFrame.push_back(ms);
+    }
+
+    ///Oldest frame number a dump of the last `frames` frames covers
+    uint32_t firstDumpedFrame(unsigned frames)
+    {
+        unsigned kept = g_framesRecorded < HISTORY_FRAMES ? g_framesRecorded : HISTORY_FRAMES;
+        if (frames > kept) {
+            frames = kept;
+        }
+        return g_framesRecorded - frames;
+    }
+
+    ///Call f on every kept sample of frame >= firstFrame, oldest first
+    template <typename F>
+    void forEachSample(uint32_t firstFrame, F&& f)
+    {
+        uint64_t first = g_historyCount > HISTORY_SAMPLES ? g_historyCount - HISTORY_SAMPLES : 0;
+        for (uint64_t k = first; k < g_historyCount; ++k) {
+            const Sample& sample = g_history[k & (HISTORY_SAMPLES - 1)];
+            if (sample.frame >= firstFrame) {
+                f(sample);
+            }
+        }
+    }
+}
+
+uint64_t Profiler::now()
+{
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(ProfileClock::now() - g_epoch).count();
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    g_enabled.store(enabled, memory_order_relaxed);
+}
+
+bool Profiler::isEnabled()
+{
+    return g_enabled.load(memory_order_relaxed);
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end, uint16_t depth)
+{
+    SampleRing* ring = threadRing();
+    Sample sample = { name, start, end, g_frame.load(memory_order_relaxed), t_thread, depth };
+    if (!ring->push(sample)) {
+        g_dropped.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void Profiler::beginFrame()
+{
+    threadRing();
+    g_frameThread = t_thread;
+    g_frameStart = now();
+
+    // Scopes inside the frame nest under the frame sample endFrame records
+    t_depth = 1;
+}
+
+void Profiler::endFrame()
+{
+    t_depth = 0;
+    const uint64_t frameEnd = now();
+    const uint32_t frame = g_frame.load(memory_order_relaxed);
+
+    if (isEnabled()) {
+        record("frame", g_frameStart, frameEnd, 0);
+    }
+
+    if (g_history.empty()) {
+        g_history.resize(HISTORY_SAMPLES);
+    }
+    for (double& ms : g_phaseThisFrame) {
+        ms = 0.0;
+    }
+
+    // Pool workers finish their chunks before the frame thread gets here; a
+    // thread running on its own clock (the simulation) may still be pushing,
+    // which the SPSC rings allow, and its later samples land in the next frame
+    {
+        lock_guard<mutex> lock(g_registryLock);
+        for (unique_ptr<SampleRing>& ring : g_rings) {
+            ring->drain([](const Sample& sample) {
+                g_history[g_historyCount & (HISTORY_SAMPLES - 1)] = sample;
+                ++g_historyCount;
+                if (sample.thread == g_frameThread && sample.depth == 1) {
+                    accumulatePhase(sample.name, (sample.end - sample.start) * 1e-6);
+                }
+            });
+        }
+    }
+
+    g_framesRecorded = frame + 1;
+
+    // Exponential moving averages keep the HUD readable at high frame rates
+    for (size_t k = 0; k < g_phases.size(); ++k) {
+        if (g_phases[k].ms < 0.0) {
+            g_phases[k].ms = g_phaseThisFrame[k];
+        }
+        else {
+            g_phases[k].ms += SMOOTHING * (g_phaseThisFrame[k] - g_phases[k].ms);
+        }
+    }
+    double ms = (frameEnd - g_frameStart) * 1e-6;
+    g_frameMs = frame == 0 ? ms : g_frameMs + SMOOTHING * (ms - g_frameMs);
+
+    g_frame.store(frame + 1, memory_order_relaxed);
+}
+
+double Profiler::frameMs()
+{
+    return g_frameMs;
+}
+
+double Profiler::fps()
+{
+    return g_frameMs > 0.0 ? 1000.0 / g_frameMs : 0.0;
+}
+
+const vector<PhaseTime>& Profiler::phaseTimes()
+{
+    return g_phases;
+}
+
+uint64_t Profiler::droppedSamples()
+{
+    return g_dropped.load(memory_order_relaxed);
+}
+
+bool Profiler::dumpCsv(const string& path, unsigned frames)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "frame,thread,depth,name,start_us,duration_us\n");
+    forEachSample(firstDumpedFrame(frames), [file](const Sample& sample) {
+        fprintf(file, "%u,%u,%u,%s,%.3f,%.3f\n", sample.frame, sample.thread, sample.depth, sample.name,
+                sample.start * 1e-3, (sample.end - sample.start) * 1e-3);
+    });
+
+    fclose(file);
+    return true;
+}
+
+bool Profiler::dumpTrace(const string& path, unsigned frames)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Chrome trace event format: one complete ("X") event per sample, times in microseconds
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    size_t threads;
+    {
+        lock_guard<mutex> lock(g_registryLock);
+        threads = g_rings.size();
+    }
+    bool first = true;
+    for (size_t t = 0; t < threads; ++t) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s %zu\"}}",
+                first ? "" : ",\n", t, (int)t == g_frameThread ? "frame thread" : "worker", t);
+        first = false;
+    }
+
+    forEachSample(firstDumpedFrame(frames), [file, &first](const Sample& sample) {
+        fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"particles\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                      "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                first ? "" : ",\n", sample.name, sample.thread,
+                sample.start * 1e-3, (sample.end - sample.start) * 1e-3, sample.frame);
+        first = false;
+    });
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+Profiler::ScopedTimer::ScopedTimer(const char* name)
+    : m_name(name), m_start(0), m_active(isEnabled())
+{
+    if (m_active) {
+        ++t_depth;
+        m_start = now();
+    }
+}
+
+Profiler::ScopedTimer::~ScopedTimer()
+{
+    if (m_active) {
+        uint64_t end = now();
+        --t_depth;
+        record(m_name, m_start, end, t_depth);
+    }
+}
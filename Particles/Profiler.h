@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+///Per-phase frame profiler.
+///PROFILE_SCOPE("name") times the rest of the enclosing block.  Each thread
+///writes its samples into its own fixed-size lock-free ring (single producer,
+///single consumer), so timing a scope costs two clock reads and a store, never
+///a lock or an allocation.  The frame thread calls beginFrame / endFrame around
+///every frame; endFrame drains every ring into a history of the last
+///HISTORY_FRAMES frames, which dumpCsv / dumpTrace write out on demand.
+///
+///Build with -DPARTICLES_NO_PROFILER to compile every PROFILE_SCOPE away.
+namespace Profiler
+{
+    ///One timed scope; times are nanoseconds since the profiler started
+    struct Sample
+    {
+        const char* name;   //string literal passed to PROFILE_SCOPE
+        uint64_t start;
+        uint64_t end;
+        uint32_t frame;
+        uint16_t thread;    //registration order; the frame thread is usually 0
+        uint16_t depth;     //nesting depth on its thread
+    };
+
+    ///Accumulated time of one top-level scope on the frame thread
+    struct PhaseTime
+    {
+        const char* name;
+        double ms;          //smoothed over recent frames
+    };
+
+    ///frames kept for dumpCsv / dumpTrace
+    const unsigned HISTORY_FRAMES = 600;
+
+    ///Nanoseconds since the profiler started
+    uint64_t now();
+
+    ///Recording is on by default; while off, scopes cost one relaxed load
+    void setEnabled(bool enabled);
+    bool isEnabled();
+
+    ///Store one finished scope in the calling thread's ring
+    void record(const char* name, uint64_t start, uint64_t end, uint16_t depth);
+
+    ///Mark the start of a frame; call from the thread that runs the frame
+    void beginFrame();
+
+    ///Close the frame: drain every thread's ring into the history and refresh
+    ///the per-phase times.  Call from the same thread as beginFrame.
+    void endFrame();
+
+    ///Smoothed frame time and rate, and the top-level scopes of the frame thread
+    double frameMs();
+    double fps();
+    const vector<PhaseTime>& phaseTimes();
+
+    ///Samples lost because a ring was full when its thread recorded
+    uint64_t droppedSamples();
+
+    ///Write the last `frames` frames as CSV: frame,thread,depth,name,start_us,duration_us
+    bool dumpCsv(const string& path, unsigned frames = HISTORY_FRAMES);
+
+    ///Write the last `frames` frames in Chrome trace event format, for
+    ///chrome://tracing or ui.perfetto.dev
+    bool dumpTrace(const string& path, unsigned frames = HISTORY_FRAMES);
+
+    ///Times its own lifetime; use through PROFILE_SCOPE
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const char* name);
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_start;
+        bool m_active;
+    };
+}
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#ifdef PARTICLES_NO_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) Profiler::ScopedTimer PROFILER_CONCAT(profileScope, __LINE__)(name)
+#endif
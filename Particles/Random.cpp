@@ -0,0 +1,132 @@
+#include "Random.h"
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+    uint64_t splitmix64(uint64_t& x)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    std::atomic<uint64_t> g_seed{1};
+    std::atomic<unsigned> g_generation{0};
+    std::atomic<uint64_t> g_nextStream{0};
+
+    struct ThreadStream
+    {
+        Rng rng;
+        unsigned generation = ~0u;
+    };
+    thread_local ThreadStream t_stream;
+}
+
+void Rng::reseed(uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed;
+    for (uint64_t& word : m_s) {
+        word = splitmix64(x);
+    }
+    for (uint64_t i = 0; i < stream; ++i) {
+        jump();
+    }
+}
+
+void Rng::fillUniform(float* out, size_t n, float lo, float hi)
+{
+    const float span = hi - lo;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = lo + span * uniformf();
+    }
+}
+
+void Rng::fillUniform(double* out, size_t n, double lo, double hi)
+{
+    const double span = hi - lo;
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = lo + span * uniform();
+    }
+}
+
+void Rng::fillRange(int* out, size_t n, int lo, int hi)
+{
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = range(lo, hi);
+    }
+}
+
+void Rng::fillSigns(float* out, size_t n)
+{
+    // 64 signs per draw
+    for (size_t i = 0; i < n; i += 64) {
+        uint64_t bits = next();
+        for (size_t k = i; k < n && k < i + 64; ++k) {
+            out[k] = (bits & 1) ? -1.0f : 1.0f;
+            bits >>= 1;
+        }
+    }
+}
+
+void Rng::fillColors(Color* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t bits = next();
+        out[i] = Color((Uint8)(bits >> 40), (Uint8)(bits >> 48), (Uint8)(bits >> 56));
+    }
+}
+
+void Rng::jump()
+{
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    for (uint64_t word : JUMP) {
+        for (int b = 0; b < 64; ++b) {
+            if (word & ((uint64_t)1 << b)) {
+                for (int k = 0; k < 4; ++k) {
+                    s[k] ^= m_s[k];
+                }
+            }
+            next();
+        }
+    }
+    for (int k = 0; k < 4; ++k) {
+        m_s[k] = s[k];
+    }
+}
+
+void Random::setSeed(uint64_t seed)
+{
+    g_seed.store(seed);
+    g_nextStream.store(0);
+    g_generation.fetch_add(1);
+}
+
+uint64_t Random::getSeed()
+{
+    return g_seed.load();
+}
+
+uint64_t Random::timeSeed()
+{
+    uint64_t x = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return splitmix64(x);
+}
+
+Rng& Random::threadRng()
+{
+    const unsigned generation = g_generation.load();
+    if (t_stream.generation != generation) {
+        t_stream.rng.reseed(g_seed.load(), g_nextStream.fetch_add(1));
+        t_stream.generation = generation;
+    }
+    return t_stream.rng;
+}
+
+Rng Random::stream(uint64_t k)
+{
+    return Rng(g_seed.load(), k);
+}
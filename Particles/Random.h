@@ -0,0 +1,97 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+
+using namespace sf;
+
+///xoshiro256** generator: fast, 256 bits of state, good quality in the low
+///and high bits.  Replaces rand() for particle spawning.
+///Streams created from the same seed with different stream numbers are
+///2^128 draws apart, so they never overlap.
+class Rng
+{
+public:
+    explicit Rng(uint64_t seed = 1, uint64_t stream = 0) { reseed(seed, stream); }
+
+    ///Expand seed with splitmix64, then jump ahead stream times
+    void reseed(uint64_t seed, uint64_t stream = 0);
+
+    uint64_t next()
+    {
+        const uint64_t result = rotl(m_s[1] * 5, 7) * 9;
+        const uint64_t t = m_s[1] << 17;
+        m_s[2] ^= m_s[0];
+        m_s[3] ^= m_s[1];
+        m_s[1] ^= m_s[2];
+        m_s[0] ^= m_s[3];
+        m_s[2] ^= t;
+        m_s[3] = rotl(m_s[3], 45);
+        return result;
+    }
+
+    ///Uniform in [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    float uniformf() { return (next() >> 40) * (1.0f / 16777216.0f); }
+
+    ///Uniform in [lo, hi)
+    double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * uniformf(); }
+
+    ///Uniform integer in [lo, hi] (inclusive), without modulo bias
+    ///(Lemire's multiply-shift with its rejection step)
+    int range(int lo, int hi)
+    {
+        const uint64_t span = (uint64_t)((int64_t)hi - lo + 1);
+        uint64_t product = (next() >> 32) * span;
+        if ((uint32_t)product < span) {
+            // 2^32 mod span of the low products would map one value too many;
+            // redraw those.  Only reached once in 2^32 / span draws
+            const uint32_t threshold = (uint32_t)((0x100000000ull - span) % span);
+            while ((uint32_t)product < threshold) {
+                product = (next() >> 32) * span;
+            }
+        }
+        return lo + (int)(product >> 32);
+    }
+
+    bool coin() { return (next() >> 63) != 0; }
+
+    //Batched fills: one call per array instead of one per value
+    void fillUniform(float* out, size_t n, float lo, float hi);
+    void fillUniform(double* out, size_t n, double lo, double hi);
+    void fillRange(int* out, size_t n, int lo, int hi);
+    ///+1.0f or -1.0f with equal probability
+    void fillSigns(float* out, size_t n);
+    ///Opaque random colors, 24 random bits each
+    void fillColors(Color* out, size_t n);
+
+    ///Advance 2^128 draws (the xoshiro256 jump polynomial)
+    void jump();
+
+private:
+    uint64_t m_s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+///Process-wide seed and per-thread streams.
+///Each thread draws from its own Rng, stream n of the current seed, where n is
+///the order in which threads first asked for one (the first caller gets 0).
+///Work that must be reproducible regardless of scheduling should use
+///Random::stream(k) with a k derived from the work item instead.
+namespace Random
+{
+    ///Set the seed every stream derives from; call once at startup
+    void setSeed(uint64_t seed);
+    uint64_t getSeed();
+
+    ///A seed from the clock, for runs that did not ask for one
+    uint64_t timeSeed();
+
+    ///This thread's generator (re-seeded automatically after setSeed)
+    Rng& threadRng();
+
+    ///An independent generator for stream k of the current seed
+    Rng stream(uint64_t k);
+}
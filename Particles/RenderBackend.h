@@ -0,0 +1,41 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+
+using namespace sf;
+using namespace std;
+
+///Where a frame's triangles end up.  Engine::draw clears the backend, then
+///hands it the whole vertex buffer, so the frame is built the same way
+///whichever backend draws it.
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() = default;
+
+    ///Start a new frame filled with color
+    virtual void clear(Color color) = 0;
+
+    ///Draw count / 3 independent triangles (count is a multiple of 3) over
+    ///what is there, later triangles over earlier ones
+    virtual void drawTriangles(const Vertex* vertices, size_t count) = 0;
+};
+
+///The usual path: SFML draws into a window (or any RenderTarget) on the GPU
+class TargetBackend : public RenderBackend
+{
+public:
+    explicit TargetBackend(RenderTarget& target) : m_target(target) {}
+
+    void clear(Color color) override { m_target.clear(color); }
+
+    void drawTriangles(const Vertex* vertices, size_t count) override
+    {
+        if (count > 0) {
+            m_target.draw(vertices, count, Triangles);
+        }
+    }
+
+private:
+    RenderTarget& m_target;
+};
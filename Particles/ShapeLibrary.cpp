@@ -0,0 +1,61 @@
+#include "ShapeLibrary.h"
+#include "InputLog.h" // For fnv1a
+#include "Particle.h" // For M_PI
+#include "Random.h"
+#include <cmath>
+
+ShapeLibrary::ShapeLibrary(int minPoints, int maxPoints, int variants, uint64_t seed)
+    : m_minPoints(minPoints), m_maxPoints(maxPoints), m_variants(variants), m_pool(variants)
+{
+    // The library has its own generator so building it never shifts the
+    // simulation's random sequence
+    Rng rng(seed);
+    vector<double> radius;
+
+    m_shapes.reserve((size_t)(maxPoints - minPoints + 1) * variants);
+    for (int n = minPoints; n <= maxPoints; ++n) {
+        m_pool.reserve(n, variants);
+        for (int v = 0; v < variants; ++v) {
+            m_shapes.push_back(m_pool.allocate(n));
+        }
+    }
+
+    // Fill once every ring is allocated: carving slabs may move the storage
+    Real* points = m_pool.data();
+    vector<double> dirX;
+    vector<double> dirY;
+    m_checksum = InputLog::FNV_OFFSET;
+    for (int n = minPoints; n <= maxPoints; ++n) {
+        // Point j's direction is j steps of dTheta: rotate the previous one
+        // instead of calling cos/sin for every point.  The error grows by an
+        // ulp or so per step, far below a pixel over 50 points.
+        const double dTheta = 2.0 * M_PI / (n - 1);
+        const double stepCos = std::cos(dTheta);
+        const double stepSin = std::sin(dTheta);
+        dirX.resize(n);
+        dirY.resize(n);
+        dirX[0] = 1.0;
+        dirY[0] = 0.0;
+        for (int j = 1; j < n; ++j) {
+            dirX[j] = dirX[j - 1] * stepCos - dirY[j - 1] * stepSin;
+            dirY[j] = dirX[j - 1] * stepSin + dirY[j - 1] * stepCos;
+        }
+
+        radius.resize(n);
+        for (int v = 0; v < variants; ++v) {
+            rng.fillUniform(radius.data(), n, 20.0, 80.0);
+            Real* p = points + 2 * (size_t)shape(n, v);
+            for (int j = 0; j < n; ++j) {
+                p[2 * j] = (Real)(radius[j] * dirX[j]);
+                p[2 * j + 1] = (Real)(radius[j] * dirY[j]);
+            }
+            m_checksum = InputLog::fnv1a(p, 2 * (size_t)n * sizeof(Real), m_checksum);
+        }
+    }
+}
+
+const ShapeLibrary& ShapeLibrary::standard()
+{
+    static const ShapeLibrary library(25, 50, 32, 0x5eed5ba9e5ULL);
+    return library;
+}
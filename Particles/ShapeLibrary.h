@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Precision.h"
+#include "VertexPool.h"
+
+using namespace std;
+
+///Immutable set of pre-generated particle outlines ("shapes").
+///A shape of n points is the ring Particle::Particle sweeps, before it is
+///placed: point j at radius r_j (random in [20:80]) and angle j * 2PI / (n - 1),
+///as (x,y) offsets from the particle's center with no start angle applied.
+///Particles reference a shape instead of owning vertices; their own start
+///angle, rotation, scale and position are applied when they are drawn.
+///
+///Every point count in [minPoints, maxPoints] gets `variants` shapes.  Shapes
+///live in VertexPool rings, so each point count's shapes share slabs.  The
+///directions of a ring come from one rotation recurrence per point count, so
+///building the library costs one cos/sin pair per point count, not per vertex.
+class ShapeLibrary
+{
+public:
+    ShapeLibrary(int minPoints, int maxPoints, int variants, uint64_t seed);
+
+    ///The library the engine spawns from: 25-50 points, 32 variants each.
+    ///Built on first use and shared, read-only, by every thread.
+    static const ShapeLibrary& standard();
+
+    int getMinPoints() const { return m_minPoints; }
+    int getMaxPoints() const { return m_maxPoints; }
+    int getVariants() const { return m_variants; }
+
+    ///FNV-1a of every shape's points: equal checksums mean shape offsets from
+    ///one library can be used with the other
+    uint64_t getChecksum() const { return m_checksum; }
+
+    ///Vertices in data(); every shape offset plus its point count is below it
+    size_t vertexCount() const { return m_pool.capacity(); }
+
+    ///Vertex offset of shape `variant` of numPoints points, for data()
+    uint32_t shape(int numPoints, int variant) const
+    {
+        return m_shapes[(size_t)(numPoints - m_minPoints) * m_variants + variant];
+    }
+
+    ///Every shape's points as interleaved (x,y) offsets
+    const Real* data() const { return m_pool.data(); }
+
+private:
+    int m_minPoints;
+    int m_maxPoints;
+    int m_variants;
+    VertexPool m_pool;
+    vector<uint32_t> m_shapes;
+    uint64_t m_checksum = 0;
+};
@@ -0,0 +1,286 @@
+#include "Simulation.h"
+#include "AllocStats.h"
+#include "Profiler.h"
+#include "Random.h"
+#include <algorithm> // For min, max
+#include <cstdint> // For SIZE_MAX
+#include <iostream>
+
+Simulation::Simulation(unsigned threadCount)
+    : m_pool(threadCount), m_commands(COMMAND_CAPACITY), m_rng(Random::stream(RNG_STREAM)), m_epoch(SimClock::now())
+{
+    ALLOC_SCOPE(AllocStats::SIMULATION);
+    m_spawnDeferred.reserve(COMMAND_CAPACITY);
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::start()
+{
+    if (isRunning()) {
+        return;
+    }
+    m_stop.store(false);
+    m_thread = thread(&Simulation::threadLoop, this);
+}
+
+void Simulation::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_stop.store(true);
+    m_thread.join();
+}
+
+bool Simulation::requestSpawn(Vector2f center, int count)
+{
+    Command command = {};
+    command.kind = Command::SPAWN;
+    command.spawn = { center, count, SimClock::now() };
+    if (!m_commands.push(command)) {
+        m_droppedCount.fetch_add(count, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+uint32_t Simulation::addEmitter(const Emitter& emitter)
+{
+    Command command = {};
+    command.kind = Command::ADD_EMITTER;
+    command.emitterId = m_nextEmitterId.fetch_add(1, memory_order_relaxed);
+    command.emitter = emitter;
+    return m_commands.push(command) ? command.emitterId : 0;
+}
+
+void Simulation::removeEmitter(uint32_t id)
+{
+    Command command = {};
+    command.kind = Command::REMOVE_EMITTER;
+    command.emitterId = id;
+    m_commands.push(command);
+}
+
+void Simulation::clearEmitters()
+{
+    Command command = {};
+    command.kind = Command::CLEAR_EMITTERS;
+    m_commands.push(command);
+}
+
+void Simulation::requestCheckpoint(const string& path)
+{
+    lock_guard<mutex> lock(m_checkpointLock);
+    m_checkpointPath = path;
+}
+
+bool Simulation::loadCheckpoint(const string& path, string& error)
+{
+    if (!m_particles.loadCheckpoint(path, error)) {
+        return false;
+    }
+    m_particleCount.store(m_particles.size(), memory_order_relaxed);
+    return true;
+}
+
+void Simulation::setRecorder(InputLog::Recorder* recorder)
+{
+    m_recorder = recorder;
+    m_recordedViewport = Vector2u(~0u, ~0u);
+    m_recordedCollisions = -1;
+}
+
+void Simulation::setViewport(Vector2u size)
+{
+    m_viewWidth.store(size.x, memory_order_relaxed);
+    m_viewHeight.store(size.y, memory_order_relaxed);
+}
+
+void Simulation::tick(float dt)
+{
+    advance(dt, now());
+}
+
+double Simulation::now() const
+{
+    return chrono::duration<double>(SimClock::now() - m_epoch).count();
+}
+
+void Simulation::threadLoop()
+{
+    const SimClock::duration step = chrono::duration_cast<SimClock::duration>(chrono::duration<double>(FIXED_DT));
+    const SimClock::duration maxLag = chrono::duration_cast<SimClock::duration>(chrono::duration<double>(MAX_LAG));
+
+    // Each tick computes the state for the end of its step ahead of time, then
+    // sleeps until that moment, so the renderer always has a snapshot at or
+    // just past the present to interpolate towards
+    SimClock::time_point due = SimClock::now();
+    while (!m_stop.load()) {
+        due += step;
+        advance(FIXED_DT, chrono::duration<double>(due - m_epoch).count());
+
+        SimClock::time_point now = SimClock::now();
+        if (now - due > maxLag) {
+            due = now;
+        }
+        else {
+            this_thread::sleep_until(due);
+        }
+    }
+}
+
+void Simulation::advance(float dt, double time)
+{
+    PROFILE_SCOPE("sim_tick");
+    ALLOC_SCOPE(AllocStats::SIMULATION);
+    SimClock::time_point start = SimClock::now();
+
+    // Drain everything queued since the last tick.  Spawns join the backlog;
+    // emitter changes take effect at once.
+    Command command;
+    bool emittersChanged = false;
+    while (m_commands.pop(command)) {
+        switch (command.kind) {
+        case Command::SPAWN:
+            m_spawnDeferred.push_back(command.spawn);
+            break;
+        case Command::ADD_EMITTER:
+            m_emitters.add(command.emitterId, command.emitter);
+            emittersChanged = true;
+            break;
+        case Command::REMOVE_EMITTER:
+            m_emitters.remove(command.emitterId);
+            break;
+        case Command::CLEAR_EMITTERS:
+            m_emitters.clear();
+            break;
+        }
+    }
+    if (emittersChanged) {
+        // Make room up front for what the emitters will keep alive, so a
+        // high-rate emitter does not grow the arrays a few particles at a time
+        m_particles.reserve(m_particles.size() + (size_t)m_emitters.steadyCount());
+    }
+    {
+        lock_guard<mutex> lock(m_checkpointLock);
+        m_checkpointWork.swap(m_checkpointPath);
+    }
+    // Settings other threads may change are read once, so the tick and its
+    // log record see the same values
+    const Vector2u viewport(m_viewWidth.load(memory_order_relaxed), m_viewHeight.load(memory_order_relaxed));
+    const bool collisions = m_collisions.load(memory_order_relaxed);
+    if (m_recorder != nullptr) {
+        if (viewport != m_recordedViewport) {
+            m_recorder->viewport(viewport);
+            m_recordedViewport = viewport;
+        }
+        if ((int)collisions != m_recordedCollisions) {
+            m_recorder->collisions(collisions);
+            m_recordedCollisions = collisions;
+        }
+    }
+
+    // The backlog goes first, in the order it was asked for.  What the cap or
+    // the budget holds back waits for the next tick; past a cap's worth of
+    // waiting particles, requests are dropped.
+    const size_t cap = m_particleCap.load(memory_order_relaxed);
+    const size_t perTick = m_spawnBudget.load(memory_order_relaxed);
+    size_t budget = perTick == 0 ? SIZE_MAX : perTick;
+    const size_t backlogLimit = cap == 0 ? SIZE_MAX : cap;
+    size_t waiting = 0;
+    size_t kept = 0;
+    double latencyMs = -1.0;
+    for (SpawnRequest request : m_spawnDeferred) {
+        const int admitted = admit(request.count, cap, budget);
+        if (admitted > 0) {
+            spawnNow(request.center, admitted);
+            request.count -= admitted;
+            latencyMs = max(latencyMs, chrono::duration<double, milli>(start - request.queuedAt).count());
+        }
+        if (request.count == 0) {
+            continue;
+        }
+        if (waiting + request.count <= backlogLimit) {
+            m_spawnDeferred[kept++] = request;
+            waiting += request.count;
+        }
+        else {
+            m_droppedCount.fetch_add(request.count, memory_order_relaxed);
+        }
+    }
+    m_spawnDeferred.resize(kept);
+    m_deferredCount.store(waiting, memory_order_relaxed);
+    if (latencyMs >= 0.0) {
+        double smoothed = m_spawnLatencyMs.load(memory_order_relaxed);
+        m_spawnLatencyMs.store(smoothed == 0.0 ? latencyMs : smoothed + 0.1 * (latencyMs - smoothed), memory_order_relaxed);
+    }
+
+    m_emitters.advance(dt, [&](Vector2f center, int count) {
+        const int admitted = admit(count, cap, budget);
+        if (admitted > 0) {
+            spawnNow(center, admitted);
+        }
+        m_droppedCount.fetch_add(count - admitted, memory_order_relaxed);
+    });
+    m_emitterCount.store(m_emitters.size(), memory_order_relaxed);
+    if (m_recorder != nullptr) {
+        m_recorder->tick(dt, time);
+    }
+
+    // Drop the particles whose TTL ran out, then step the rest by exactly dt
+    m_particles.removeExpired();
+    m_particles.update(dt);
+    m_particles.setCollisions(collisions);
+    m_particles.collide(m_pool);
+
+    // Only what is on screen goes into the snapshot; what can never be again
+    // stops being simulated
+    CartesianView view(viewport);
+    m_particles.cull(view.getBounds(), m_pool);
+
+    m_particles.snapshot(m_snapshots.back(), m_tick++, time, m_pool);
+    m_snapshots.publish();
+    m_particleCount.store(m_particles.size(), memory_order_relaxed);
+
+    // A checkpoint waits for the tick to finish so it holds a whole step
+    if (!m_checkpointWork.empty()) {
+        if (m_particles.saveCheckpoint(m_checkpointWork)) {
+            cout << "Saved " << m_particles.size() << " particles to " << m_checkpointWork << endl;
+        }
+        else {
+            cerr << "Could not write checkpoint " << m_checkpointWork << endl;
+        }
+        m_checkpointWork.clear();
+    }
+
+    double ms = chrono::duration<double, milli>(SimClock::now() - start).count();
+    double smoothed = m_tickMs.load(memory_order_relaxed);
+    m_tickMs.store(smoothed == 0.0 ? ms : smoothed + 0.1 * (ms - smoothed), memory_order_relaxed);
+}
+
+void Simulation::spawnNow(Vector2f center, int count)
+{
+    if (m_recorder != nullptr) {
+        m_recorder->spawn(center, count);
+    }
+    // Generate random numPoints in the range [25:50] for every particle at once
+    m_spawnPoints.resize(count);
+    m_rng.fillRange(m_spawnPoints.data(), count, 25, 50);
+    m_particles.spawn(center, m_spawnPoints.data(), count, m_rng);
+}
+
+int Simulation::admit(int count, size_t cap, size_t& budget) const
+{
+    size_t room = budget;
+    if (cap != 0) {
+        const size_t alive = m_particles.size();
+        room = alive >= cap ? 0 : min(room, cap - alive);
+    }
+    const int admitted = (int)min((size_t)count, room);
+    budget -= admitted;
+    return admitted;
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Emitter.h"
+#include "InputLog.h"
+#include "MpscQueue.h"
+#include "ParticleSystem.h"
+#include "Random.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+using namespace sf;
+using namespace std;
+
+///Fixed-timestep particle simulation.
+///start() runs it on a thread of its own: every FIXED_DT seconds of wall time
+///it applies queued spawns, advances the particles by exactly FIXED_DT and
+///publishes a Snapshot, whatever the render thread is doing.  A slow frame
+///only means the renderer skips snapshots; it never lengthens a physics step.
+///If the simulation itself falls more than MAX_LAG behind (debugger, suspended
+///laptop) it drops the backlog instead of bursting through it.
+///
+///Without start() the same tick is driven by hand through tick(), which is
+///how headless runs and benchmarks stay deterministic.
+///
+///Input reaches the simulation through a lock-free queue of small commands
+///(spawn here, add or remove an emitter).  Queueing one costs the input
+///thread a few stores and never waits for a tick.  Each tick drains the whole
+///queue, then spawns from the backlog, at most the spawn budget's worth of
+///particles: a burst bigger than that is spread over the next ticks, in the
+///order it was asked for, instead of stalling one.
+///
+///Spawns draw from the simulation's own random stream, never a thread's, so
+///the same seed and the same InputLog records give the same particles
+///whichever thread runs the ticks.  Emitters fire through the same path, and
+///every shot is logged as a spawn, so a replay needs no emitters of its own.
+class Simulation
+{
+public:
+    static constexpr float FIXED_DT = 1.0f / 120.0f;
+    static constexpr double MAX_LAG = 0.25;
+
+    ///threadCount sizes the simulation's own pool (0 = one per hardware thread)
+    explicit Simulation(unsigned threadCount = 0);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_thread.joinable(); }
+
+    ///Restart the spawn stream from the current Random seed; call after
+    ///Random::setSeed.  Only while the simulation thread is not running.
+    void reseed() { m_rng = Random::stream(RNG_STREAM); }
+
+    ///Log every tick's inputs to recorder (nullptr stops).  Only while the
+    ///simulation thread is not running; recorder must outlive the recording.
+    void setRecorder(InputLog::Recorder* recorder);
+
+    ///Queue count particles at center (Cartesian coordinates) for the next
+    ///tick.  Safe to call from any thread; never blocks.  False if the queue
+    ///is full (COMMAND_CAPACITY requests since the last tick); the request is
+    ///then dropped.
+    bool requestSpawn(Vector2f center, int count);
+
+    ///Particles spawned per tick at most, from requests and emitters together
+    ///(0 = no limit).  Requests over it wait for the next tick; emitter shots
+    ///over it are dropped.  Safe to call from any thread.
+    void setSpawnBudget(size_t perTick) { m_spawnBudget.store(perTick, memory_order_relaxed); }
+    ///Smoothed time from requestSpawn to the tick that spawned it, in milliseconds
+    double getSpawnLatencyMs() const { return m_spawnLatencyMs.load(memory_order_relaxed); }
+
+    ///Start emitter from the next tick; returns its id for removeEmitter.
+    ///Room for the particles it keeps alive is reserved when it is added.
+    ///Safe to call from any thread, as are removeEmitter and clearEmitters.
+    uint32_t addEmitter(const Emitter& emitter);
+    void removeEmitter(uint32_t id);
+    void clearEmitters();
+    ///Emitters running after the last tick
+    size_t getEmitterCount() const { return m_emitterCount.load(memory_order_relaxed); }
+
+    ///Admission control: spawns stop once count particles are alive (0, the
+    ///default, is no limit).  Requested spawns that do not fit wait for room,
+    ///up to a backlog of another count particles; emitter shots that do not
+    ///fit are dropped.  Safe to call from any thread.
+    void setParticleCap(size_t count) { m_particleCap.store(count, memory_order_relaxed); }
+    size_t getParticleCap() const { return m_particleCap.load(memory_order_relaxed); }
+    ///Particles held back by the cap or the spawn budget and still waiting
+    size_t getDeferredSpawns() const { return m_deferredCount.load(memory_order_relaxed); }
+    ///Particles turned away for good (cap, spawn budget, full queue) since the start
+    uint64_t getDroppedSpawns() const { return m_droppedCount.load(memory_order_relaxed); }
+
+    ///Save every particle to path at the end of the next tick, on the
+    ///simulation thread, and report how it went on stdout.  Safe to call from
+    ///any thread.
+    void requestCheckpoint(const string& path);
+    ///Save every particle to path now.  Only while the simulation thread is
+    ///not running.
+    bool saveCheckpoint(const string& path) { return m_particles.saveCheckpoint(path); }
+    ///Replace every particle with those saved at path (see
+    ///ParticleSystem::loadCheckpoint).  Only while the simulation thread is not
+    ///running.
+    bool loadCheckpoint(const string& path, string& error);
+
+    ///Size in pixels of the window the snapshots are drawn into; particles
+    ///outside it are left out of snapshots, and retired once they cannot come
+    ///back.  (0,0), the default, draws everything.  Safe to call from any thread.
+    void setViewport(Vector2u size);
+
+    ///Turn particle-particle collisions on or off from the next tick.  Safe
+    ///to call from any thread.
+    void setCollisions(bool on) { m_collisions.store(on, memory_order_relaxed); }
+    bool getCollisions() const { return m_collisions.load(memory_order_relaxed); }
+
+    ///Run one tick of dt seconds on the calling thread and publish its
+    ///snapshot.  Only while the simulation thread is not running.
+    void tick(float dt);
+
+    ///Seconds of wall time since the simulation was created, on the same
+    ///clock as Snapshot::time
+    double now() const;
+
+    SnapshotExchange& snapshots() { return m_snapshots; }
+
+    unsigned getThreadCount() const { return m_pool.getThreadCount(); }
+    ///Ticks run so far
+    uint64_t getTick() const { return m_tick; }
+    ///FNV-1a of every live particle's state, for replay checks.  Only while
+    ///the simulation thread is not running.
+    uint64_t checksum() const { return m_particles.checksum(); }
+    ///Live particles after the last tick
+    size_t getParticleCount() const { return m_particleCount.load(memory_order_relaxed); }
+    ///Smoothed cost of one tick in milliseconds
+    double getTickMs() const { return m_tickMs.load(memory_order_relaxed); }
+
+private:
+    typedef chrono::steady_clock SimClock;
+
+    struct SpawnRequest
+    {
+        Vector2f center;
+        int count;
+        SimClock::time_point queuedAt;
+    };
+
+    ///One input for the simulation thread; only the fields of its kind are set
+    struct Command
+    {
+        enum Kind : uint8_t { SPAWN, ADD_EMITTER, REMOVE_EMITTER, CLEAR_EMITTERS };
+        Kind kind;
+        uint32_t emitterId;
+        SpawnRequest spawn;
+        Emitter emitter;
+    };
+
+    ///Random::stream the spawns draw from
+    static const uint64_t RNG_STREAM = 64;
+
+    ///Commands the queue holds between two ticks
+    static const size_t COMMAND_CAPACITY = 8192;
+    ///Default spawn budget: 20000 particles a tick is 2.4 million a second
+    static const size_t SPAWN_BUDGET = 20000;
+
+    ParticleSystem m_particles;
+    ThreadPool m_pool;
+    SnapshotExchange m_snapshots;
+    uint64_t m_tick = 0;
+
+    //input from any thread, drained by the ticking thread
+    MpscQueue<Command> m_commands;
+    //spawn requests drained but not yet spawned, oldest first; simulation thread only
+    vector<SpawnRequest> m_spawnDeferred;
+    vector<int> m_spawnPoints;
+    Rng m_rng;
+
+    //emitters, which only the ticking thread touches
+    EmitterSet m_emitters;
+    atomic<uint32_t> m_nextEmitterId{1};
+    atomic<size_t> m_emitterCount{0};
+
+    //checkpoint to save at the end of the next tick, if any, queued under
+    //m_checkpointLock and taken by the tick that saves it; rare enough for a lock
+    mutex m_checkpointLock;
+    string m_checkpointPath;
+    string m_checkpointWork;
+
+    //inputs logged so far, to record settings only when they change
+    InputLog::Recorder* m_recorder = nullptr;
+    Vector2u m_recordedViewport;
+    int m_recordedCollisions = -1;
+
+    thread m_thread;
+    atomic<bool> m_stop{false};
+    const SimClock::time_point m_epoch;
+
+    //viewport for culling, in pixels; read once per tick
+    atomic<unsigned> m_viewWidth{0};
+    atomic<unsigned> m_viewHeight{0};
+    atomic<bool> m_collisions{false};
+
+    atomic<size_t> m_particleCap{0};
+    atomic<size_t> m_spawnBudget{SPAWN_BUDGET};
+    atomic<double> m_spawnLatencyMs{0.0};
+    atomic<size_t> m_deferredCount{0};
+    atomic<uint64_t> m_droppedCount{0};
+
+    atomic<size_t> m_particleCount{0};
+    atomic<double> m_tickMs{0.0};
+
+    void threadLoop();
+    ///One step of dt, published as representing wall time `time`
+    void advance(float dt, double time);
+    ///Log and add count particles at center, drawing from m_rng
+    void spawnNow(Vector2f center, int count);
+    ///How many of count particles fit under cap (0 = no cap) right now and
+    ///in what is left of this tick's budget, which they are taken out of
+    int admit(int count, size_t cap, size_t& budget) const;
+};
@@ -0,0 +1,150 @@
+#include "Snapshot.h"
+#include "Particle.h" // For M_PI
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    ///particles handed to each pool task
+    const size_t DRAW_GRAIN = 1024;
+
+    inline float lerp(float a, float b, float t)
+    {
+        return a + t * (b - a);
+    }
+
+    ///Ring points to step over per fan triangle so a ring of count points at
+    ///scale has edges of about lodEdge pixels.  Edges are judged at the mean
+    ///ShapeLibrary radius, halfway between its 20 and 80.
+    inline uint32_t lodStride(uint32_t count, float scale, float lodEdge)
+    {
+        if (lodEdge <= 0.0f || count < 8) {
+            return 1;
+        }
+        const float edge = (float)(2.0 * M_PI * 50.0) * scale / (float)(count - 1);
+        const uint32_t stride = edge > 0.0f ? (uint32_t)min(lodEdge / edge + 0.5f, 1e6f) : count;
+        return min(max(stride, 1u), (count - 1) / 3);
+    }
+
+    ///Triangles in a fan over a ring of count points taken every stride points
+    inline uint32_t fanTriangles(uint32_t count, uint32_t stride)
+    {
+        return (count - 1 + stride - 1) / stride;
+    }
+}
+
+void SnapshotExchange::publish()
+{
+    m_back = m_middle.exchange(m_back | FRESH, memory_order_acq_rel) & INDEX_MASK;
+}
+
+bool SnapshotExchange::acquire()
+{
+    if ((m_middle.load(memory_order_acquire) & FRESH) == 0) {
+        return false;
+    }
+
+    // Only the consumer clears FRESH, so the middle slot is still the new one
+    int fresh = m_middle.exchange(m_previous, memory_order_acq_rel) & INDEX_MASK;
+    m_previous = m_current;
+    m_current = fresh;
+    return true;
+}
+
+void buildTriangles(const Snapshot& previous, const Snapshot& current, float alpha,
+                    const CartesianView& view, vector<Vertex>& out, ThreadPool& pool)
+{
+    vector<uint32_t> unused;
+    buildTriangles(previous, current, alpha, view, out, pool, 0.0f, unused);
+}
+
+void buildTriangles(const Snapshot& previous, const Snapshot& current, float alpha,
+                    const CartesianView& view, vector<Vertex>& out, ThreadPool& pool,
+                    float lodEdgePixels, vector<uint32_t>& triangleStart)
+{
+    PROFILE_SCOPE("build_triangles");
+
+    // At full detail a particle's triangles start at 3 * (ring vertices before
+    // it - particles before it).  With LOD every particle's count depends on
+    // its size, so one serial pass lays them out first.
+    const bool lod = lodEdgePixels > 0.0f;
+    if (lod) {
+        triangleStart.resize(current.size() + 1);
+        uint32_t total = 0;
+        for (size_t i = 0; i < current.size(); ++i) {
+            const uint32_t count = current.vertexStart[i + 1] - current.vertexStart[i];
+            triangleStart[i] = total;
+            total += fanTriangles(count, lodStride(count, current.scale[i], lodEdgePixels));
+        }
+        triangleStart[current.size()] = total;
+        out.resize(3 * (size_t)total);
+    }
+    else {
+        out.resize(current.triangleVertexCount());
+    }
+    if (current.empty()) {
+        return;
+    }
+
+    alpha = min(max(alpha, 0.0f), 1.0f);
+    const bool interpolate = alpha < 1.0f && !previous.empty();
+    Vertex* triangles = out.data();
+
+    pool.parallelFor(current.size(), DRAW_GRAIN, [&](size_t begin, size_t end) {
+        PROFILE_SCOPE("triangles_chunk");
+
+        // Both snapshots are sorted by id: find this chunk's first particle in
+        // previous once, then walk the two lists together
+        size_t p = 0;
+        if (interpolate) {
+            p = lower_bound(previous.id.begin(), previous.id.end(), current.id[begin]) - previous.id.begin();
+        }
+
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t first = current.vertexStart[i];
+            const uint32_t count = current.vertexStart[i + 1] - first;
+            const Real* shape = current.shapes + 2 * (size_t)current.shape[i];
+            Vector2f centerXY(current.centerX[i], current.centerY[i]);
+            float angle = current.angle[i];
+            float scale = current.scale[i];
+            // Judged on this tick's scale, as the layout was
+            const uint32_t stride = lod ? lodStride(count, scale, lodEdgePixels) : 1;
+
+            if (interpolate) {
+                while (p < previous.size() && previous.id[p] < current.id[i]) {
+                    ++p;
+                }
+                if (p < previous.size() && previous.id[p] == current.id[i]) {
+                    centerXY.x = lerp(previous.centerX[p], centerXY.x, alpha);
+                    centerXY.y = lerp(previous.centerY[p], centerXY.y, alpha);
+                    angle = lerp(previous.angle[p], angle, alpha);
+                    scale = lerp(previous.scale[p], scale, alpha);
+                }
+            }
+
+            // Rotation and scale of the whole ring as one 2x2 matrix
+            const float c = scale * std::cos(angle);
+            const float s = scale * std::sin(angle);
+
+            Vertex* tri = triangles + 3 * (lod ? (size_t)triangleStart[i] : (size_t)first - i);
+            Vector2f center = view.coordsToPixel(centerXY.x, centerXY.y);
+
+            // Fan (center, v[j], v[j + stride]) around the ring; the last point
+            // always closes it, however the stride divides the ring
+            Vector2f prev = view.coordsToPixel(centerXY.x + c * (float)shape[0] - s * (float)shape[1],
+                                               centerXY.y + s * (float)shape[0] + c * (float)shape[1]);
+            for (uint32_t j = stride; j < count - 1 + stride; j += stride) {
+                const uint32_t k = min(j, count - 1);
+                const float tx = (float)shape[2 * k];
+                const float ty = (float)shape[2 * k + 1];
+                Vector2f next = view.coordsToPixel(centerXY.x + c * tx - s * ty, centerXY.y + s * tx + c * ty);
+                tri[0] = Vertex(center, current.color1[i]);
+                tri[1] = Vertex(prev, current.color2[i]);
+                tri[2] = Vertex(next, current.color2[i]);
+                tri += 3;
+                prev = next;
+            }
+        }
+    });
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "CartesianView.h"
+#include "Precision.h"
+#include "ThreadPool.h"
+
+using namespace sf;
+using namespace std;
+
+///Everything the renderer needs from one simulation tick, copied out of the
+///ParticleSystem so the simulation can move on while the frame is drawn.
+///Particles are in spawn order, so ids strictly increase.  A particle is its
+///center, angle and scale plus a ShapeLibrary shape: its ring is the
+///vertexStart[i + 1] - vertexStart[i] (x,y) offsets at shapes + 2 * shape[i],
+///rotated by angle[i], scaled by scale[i] and moved to the center.
+///vertexStart is where each ring lands in the frame's vertex count.
+struct Snapshot
+{
+    uint64_t tick = 0;
+    //wall-clock time (seconds since the simulation started) the state belongs to
+    double time = 0.0;
+
+    vector<uint64_t> id;
+    vector<float> centerX;
+    vector<float> centerY;
+    vector<float> angle;
+    vector<float> scale;
+    vector<uint32_t> shape;         //vertex offset into shapes
+    vector<Color> color1;
+    vector<Color> color2;
+    vector<uint32_t> vertexStart;   //size() + 1 entries
+    //the ShapeLibrary's points; immutable and shared, never copied
+    const Real* shapes = nullptr;
+
+    size_t size() const { return id.size(); }
+    size_t vertexCount() const { return vertexStart.empty() ? 0 : vertexStart.back(); }
+    bool empty() const { return id.empty(); }
+
+    ///Vertices buildTriangles writes: each fan of n ring vertices is n - 1 triangles
+    size_t triangleVertexCount() const { return 3 * (vertexCount() - size()); }
+};
+
+///Hands snapshots from the simulation thread to the render thread without locks.
+///A triple buffer (the producer's back slot, a shared middle slot, the
+///consumer's current slot) plus a fourth slot the consumer keeps as the previous
+///snapshot to interpolate from.  publish() swaps the back slot into the middle;
+///acquire() trades the consumer's oldest slot for the middle one when it is new.
+///Neither side ever waits for the other.
+class SnapshotExchange
+{
+public:
+    ///Producer: the slot to fill next
+    Snapshot& back() { return m_slots[m_back]; }
+
+    ///Producer: make back() the newest snapshot and take a free slot in exchange
+    void publish();
+
+    ///Consumer: pick up the newest snapshot if one arrived since the last call.
+    ///The old current() becomes previous().
+    bool acquire();
+
+    const Snapshot& current() const { return m_slots[m_current]; }
+    const Snapshot& previous() const { return m_slots[m_previous]; }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;
+
+    Snapshot m_slots[4];
+    int m_back = 0;                 //producer only
+    atomic<int> m_middle{1};        //slot index, | FRESH when not yet acquired
+    int m_current = 2;              //consumer only
+    int m_previous = 3;             //consumer only
+};
+
+///Fill out with every particle of current as plain triangles in pixels, ready
+///for a single target.draw(..., Triangles); this is where rings are placed.
+///Particles that also appear in previous are drawn alpha of the way from their
+///previous to their current center, angle and scale; particles new in current
+///are drawn where current has them.
+///out is resized, never shrunk.
+void buildTriangles(const Snapshot& previous, const Snapshot& current, float alpha,
+                    const CartesianView& view, vector<Vertex>& out, ThreadPool& pool);
+
+///The same at reduced detail: a particle whose fan edges would be shorter
+///than lodEdgePixels on screen skips ring points so they are not, down to a
+///3 triangle fan.  Small and shrunken particles lose the most; 0 is full
+///detail.  triangleStart is scratch space for the layout, reused between calls.
+void buildTriangles(const Snapshot& previous, const Snapshot& current, float alpha,
+                    const CartesianView& view, vector<Vertex>& out, ThreadPool& pool,
+                    float lodEdgePixels, vector<uint32_t>& triangleStart);
@@ -0,0 +1,448 @@
+#include "SoftwareRasterizer.h"
+#include "Profiler.h"
+#include <algorithm> // For min, max, find
+#include <cmath> // For ceil, floor
+#include <cstdio>
+#include <cstring> // For memcpy
+
+namespace
+{
+    ///Inclusive pixel rectangle
+    struct PixelRect
+    {
+        int x0, y0, x1, y1;
+    };
+
+    ///Twice the signed area of abc; positive when abc turns clockwise on screen
+    float doubleArea(const Vertex& a, const Vertex& b, const Vertex& c)
+    {
+        return (b.position.x - a.position.x) * (c.position.y - a.position.y) -
+               (b.position.y - a.position.y) * (c.position.x - a.position.x);
+    }
+
+    ///The pixels whose centers (x + 0.5, y + 0.5) may fall inside abc, clipped
+    ///to size; false if there are none
+    bool pixelBounds(const Vertex& a, const Vertex& b, const Vertex& c, Vector2u size, PixelRect& out)
+    {
+        const float minX = min({ a.position.x, b.position.x, c.position.x });
+        const float maxX = max({ a.position.x, b.position.x, c.position.x });
+        const float minY = min({ a.position.y, b.position.y, c.position.y });
+        const float maxY = max({ a.position.y, b.position.y, c.position.y });
+        const float x0 = ceil(minX - 0.5f), x1 = floor(maxX - 0.5f);
+        const float y0 = ceil(minY - 0.5f), y1 = floor(maxY - 0.5f);
+        // Written so NaN fails too
+        if (!(x0 <= x1 && y0 <= y1)) {
+            return false;
+        }
+        // Clamp before converting so coordinates far off screen stay in int range
+        out.x0 = (int)min(max(x0, 0.0f), (float)size.x);
+        out.x1 = (int)max(min(x1, (float)size.x - 1.0f), -1.0f);
+        out.y0 = (int)min(max(y0, 0.0f), (float)size.y);
+        out.y1 = (int)max(min(y1, (float)size.y - 1.0f), -1.0f);
+        return out.x0 <= out.x1 && out.y0 <= out.y1;
+    }
+
+    ///Fill the pixels of clip whose centers are inside abc, Gouraud shaded.
+    ///With a coverage mask (one byte per pixel of clip, TILE to a row) only
+    ///pixels not yet covered are written, and marked; returns how many.
+    size_t rasterizeTriangle(Vertex a, Vertex b, Vertex c, const PixelRect& clip, uint8_t* pixels, unsigned width,
+                             uint8_t* covered)
+    {
+        float area = doubleArea(a, b, c);
+        if (!(area != 0.0f)) {
+            return 0;
+        }
+        // One winding for everything below: each edge function is then
+        // positive inside, and equals area at the opposite vertex
+        if (area < 0.0f) {
+            swap(b, c);
+            area = -area;
+        }
+
+        PixelRect box;
+        if (!pixelBounds(a, b, c, Vector2u(width, ~0u), box)) {
+            return 0;
+        }
+        box.x0 = max(box.x0, clip.x0);
+        box.x1 = min(box.x1, clip.x1);
+        box.y0 = max(box.y0, clip.y0);
+        box.y1 = min(box.y1, clip.y1);
+        if (box.x0 > box.x1 || box.y0 > box.y1) {
+            return 0;
+        }
+
+        const float ax = a.position.x, ay = a.position.y;
+        const float bx = b.position.x, by = b.position.y;
+        const float cx = c.position.x, cy = c.position.y;
+
+        // w0 weighs a (edge bc), w1 weighs b (edge ca), w2 weighs c (edge ab).
+        // Each changes by a constant per pixel to the right.
+        const float step[3] = { -(cy - by), -(ay - cy), -(by - ay) };
+
+        // Per-channel weights with 1 / area folded in
+        const float inv = 1.0f / area;
+        const float channels[4][3] = {
+            { a.color.r * inv, b.color.r * inv, c.color.r * inv },
+            { a.color.g * inv, b.color.g * inv, c.color.g * inv },
+            { a.color.b * inv, b.color.b * inv, c.color.b * inv },
+            { a.color.a * inv, b.color.a * inv, c.color.a * inv },
+        };
+        const bool opaque = a.color.a == 255 && b.color.a == 255 && c.color.a == 255;
+
+        size_t written = 0;
+        for (int y = box.y0; y <= box.y1; ++y) {
+            const float py = y + 0.5f;
+            const float rowStart[3] = {
+                (cx - bx) * (py - by) - (cy - by) * (box.x0 + 0.5f - bx),
+                (ax - cx) * (py - cy) - (ay - cy) * (box.x0 + 0.5f - cx),
+                (bx - ax) * (py - ay) - (by - ay) * (box.x0 + 0.5f - ax),
+            };
+
+            // A fan's slices are thin, so most of the box is outside them:
+            // solve each edge for where this row crosses it and only walk
+            // that span, a pixel wider each side to absorb the rounding
+            float left = (float)box.x0, right = (float)box.x1;
+            for (int e = 0; e < 3; ++e) {
+                if (step[e] > 0.0f) {
+                    left = max(left, box.x0 - rowStart[e] / step[e]);
+                }
+                else if (step[e] < 0.0f) {
+                    right = min(right, box.x0 - rowStart[e] / step[e]);
+                }
+                else if (rowStart[e] < 0.0f) {
+                    right = left - 3.0f;
+                }
+            }
+            if (!(left <= right + 2.0f)) {
+                continue;
+            }
+            const int x0 = max(box.x0, (int)min(left, (float)box.x1) - 1);
+            const int x1 = min(box.x1, (int)max(right, (float)box.x0) + 1);
+
+            // Evaluated directly at each span start, so rounding never builds
+            // up from one row to the next
+            const float px = x0 + 0.5f;
+            float w0 = (cx - bx) * (py - by) - (cy - by) * (px - bx);
+            float w1 = (ax - cx) * (py - cy) - (ay - cy) * (px - cx);
+            float w2 = (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+            uint8_t* pixel = pixels + ((size_t)y * width + x0) * 4;
+            uint8_t* mask = covered != nullptr ? covered + (y - clip.y0) * SoftwareRasterizer::TILE + (x0 - clip.x0) : nullptr;
+
+            for (int x = x0; x <= x1; ++x, pixel += 4, w0 += step[0], w1 += step[1], w2 += step[2]) {
+                // Edges are inclusive: a pixel on the edge two triangles of a
+                // fan share is written twice with (almost) the same color,
+                // which is invisible, where a gap would not be
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                    continue;
+                }
+                if (mask != nullptr) {
+                    if (mask[x - x0]) {
+                        continue;
+                    }
+                    mask[x - x0] = 1;
+                }
+                ++written;
+                uint8_t color[4];
+                for (int k = 0; k < 4; ++k) {
+                    const float value = w0 * channels[k][0] + w1 * channels[k][1] + w2 * channels[k][2] + 0.5f;
+                    color[k] = (uint8_t)min(max(value, 0.0f), 255.0f);
+                }
+                if (opaque || color[3] == 255) {
+                    memcpy(pixel, color, 4);
+                }
+                else {
+                    // Source over: the same blend SFML's default BlendAlpha does
+                    const unsigned alpha = color[3];
+                    for (int k = 0; k < 3; ++k) {
+                        pixel[k] = (uint8_t)((color[k] * alpha + pixel[k] * (255 - alpha) + 127) / 255);
+                    }
+                    pixel[3] = (uint8_t)(alpha + (pixel[3] * (255 - alpha) + 127) / 255);
+                }
+            }
+        }
+        return written;
+    }
+
+    // PNG chunk checksum (CRC-32 as in zlib) and zlib's stream checksum
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        static const vector<uint32_t> table = [] {
+            vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size)
+    {
+        uint32_t a = adler & 0xFFFF, b = adler >> 16;
+        for (size_t i = 0; i < size; ++i) {
+            a = (a + data[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    void putBigEndian(vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    ///Length, type, data and CRC of one PNG chunk
+    bool writeChunk(FILE* file, const char type[4], const vector<uint8_t>& data)
+    {
+        vector<uint8_t> head;
+        putBigEndian(head, (uint32_t)data.size());
+        head.insert(head.end(), type, type + 4);
+        uint32_t crc = crc32(0, head.data() + 4, 4);
+        crc = crc32(crc, data.data(), data.size());
+        vector<uint8_t> tail;
+        putBigEndian(tail, crc);
+        return fwrite(head.data(), 1, head.size(), file) == head.size() &&
+               fwrite(data.data(), 1, data.size(), file) == data.size() &&
+               fwrite(tail.data(), 1, tail.size(), file) == tail.size();
+    }
+}
+
+SoftwareRasterizer::SoftwareRasterizer(ThreadPool& pool, Vector2u size)
+    : m_pool(pool)
+{
+    setSize(size);
+}
+
+void SoftwareRasterizer::setSize(Vector2u size)
+{
+    if (size == m_size) {
+        return;
+    }
+    m_size = size;
+    m_tilesX = (size.x + TILE - 1) / TILE;
+    m_tilesY = (size.y + TILE - 1) / TILE;
+    m_pixels.resize((size_t)size.x * size.y * 4);
+    m_binStart.resize((size_t)m_tilesX * m_tilesY + 1);
+}
+
+void SoftwareRasterizer::clear(Color color)
+{
+    const uint8_t rgba[4] = { color.r, color.g, color.b, color.a };
+    const unsigned width = m_size.x;
+    m_pool.parallelFor(m_size.y, 16, [&](size_t begin, size_t end) {
+        uint8_t* row = m_pixels.data() + begin * width * 4;
+        for (size_t i = 0; i < (end - begin) * width; ++i, row += 4) {
+            memcpy(row, rgba, 4);
+        }
+    });
+}
+
+void SoftwareRasterizer::drawTriangles(const Vertex* vertices, size_t count)
+{
+    PROFILE_SCOPE("raster");
+
+    const size_t triangles = count / 3;
+    const size_t tiles = (size_t)m_tilesX * m_tilesY;
+    if (triangles == 0 || tiles == 0) {
+        return;
+    }
+
+    // 1. Which tiles each triangle touches, counted per chunk
+    const size_t chunks = (triangles + BIN_GRAIN - 1) / BIN_GRAIN;
+    m_spans.resize(triangles);
+    m_binCounts.assign(chunks * tiles, 0);
+    m_chunkOpaque.assign(chunks, 1);
+    m_pool.parallelFor(chunks, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            uint32_t* counts = m_binCounts.data() + chunk * tiles;
+            const size_t end = min(triangles, (chunk + 1) * BIN_GRAIN);
+            for (size_t t = chunk * BIN_GRAIN; t < end; ++t) {
+                const Vertex* v = vertices + 3 * t;
+                if (v[0].color.a != 255 || v[1].color.a != 255 || v[2].color.a != 255) {
+                    m_chunkOpaque[chunk] = 0;
+                }
+                TileSpan& span = m_spans[t];
+                PixelRect box;
+                if (!(doubleArea(v[0], v[1], v[2]) != 0.0f) || !pixelBounds(v[0], v[1], v[2], m_size, box)) {
+                    span = { 1, 0, 0, 0 };
+                    continue;
+                }
+                span = { (uint16_t)(box.x0 / TILE), (uint16_t)(box.y0 / TILE),
+                         (uint16_t)(box.x1 / TILE), (uint16_t)(box.y1 / TILE) };
+                for (unsigned ty = span.y0; ty <= span.y1; ++ty) {
+                    for (unsigned tx = span.x0; tx <= span.x1; ++tx) {
+                        ++counts[ty * m_tilesX + tx];
+                    }
+                }
+            }
+        }
+    });
+
+    // 2. Lay the bins out tile by tile, and within a tile chunk by chunk, so a
+    //    tile's triangles stay in draw order.  The counts become each chunk's
+    //    write cursor into its slice of the tile's bin.
+    uint32_t total = 0;
+    for (size_t tile = 0; tile < tiles; ++tile) {
+        m_binStart[tile] = total;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            uint32_t& slot = m_binCounts[chunk * tiles + tile];
+            const uint32_t n = slot;
+            slot = total;
+            total += n;
+        }
+    }
+    m_binStart[tiles] = total;
+    m_binned.resize(total);
+
+    m_pool.parallelFor(chunks, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            uint32_t* cursors = m_binCounts.data() + chunk * tiles;
+            const size_t end = min(triangles, (chunk + 1) * BIN_GRAIN);
+            for (size_t t = chunk * BIN_GRAIN; t < end; ++t) {
+                const TileSpan& span = m_spans[t];
+                for (unsigned ty = span.y0; span.x0 <= span.x1 && ty <= span.y1; ++ty) {
+                    for (unsigned tx = span.x0; tx <= span.x1; ++tx) {
+                        m_binned[cursors[ty * m_tilesX + tx]++] = (uint32_t)t;
+                    }
+                }
+            }
+        }
+    });
+
+    m_opaque = find(m_chunkOpaque.begin(), m_chunkOpaque.end(), 0) == m_chunkOpaque.end();
+
+    // 3. Every tile on its own; busy tiles are balanced by the pool's stealing
+    m_pool.parallelFor(tiles, 1, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; ++tile) {
+            rasterizeTile((unsigned)tile, vertices);
+        }
+    });
+}
+
+void SoftwareRasterizer::rasterizeTile(unsigned tile, const Vertex* vertices)
+{
+    const unsigned tx = tile % m_tilesX;
+    const unsigned ty = tile / m_tilesX;
+    PixelRect clip;
+    clip.x0 = (int)(tx * TILE);
+    clip.y0 = (int)(ty * TILE);
+    clip.x1 = (int)min((tx + 1) * TILE, m_size.x) - 1;
+    clip.y1 = (int)min((ty + 1) * TILE, m_size.y) - 1;
+
+    const uint32_t* first = m_binned.data() + m_binStart[tile];
+    const uint32_t* last = m_binned.data() + m_binStart[tile + 1];
+    if (!m_opaque) {
+        // Blending needs what is underneath first: back to front
+        for (const uint32_t* t = first; t != last; ++t) {
+            const Vertex* v = vertices + 3 * (size_t)*t;
+            rasterizeTriangle(v[0], v[1], v[2], clip, m_pixels.data(), m_size.x, nullptr);
+        }
+        return;
+    }
+
+    // Nothing is see-through, so each pixel ends up as the last triangle over
+    // it left it.  Walking the list from the end and only writing pixels not
+    // yet covered gives the same picture, and stops as soon as the whole tile
+    // is covered: with heavy overdraw most triangles are never rasterized.
+    uint8_t covered[TILE * TILE] = {};
+    size_t uncovered = (size_t)(clip.x1 - clip.x0 + 1) * (clip.y1 - clip.y0 + 1);
+    for (const uint32_t* t = last; t != first && uncovered > 0;) {
+        --t;
+        const Vertex* v = vertices + 3 * (size_t)*t;
+        uncovered -= rasterizeTriangle(v[0], v[1], v[2], clip, m_pixels.data(), m_size.x, covered);
+    }
+}
+
+Color SoftwareRasterizer::getPixel(unsigned x, unsigned y) const
+{
+    const uint8_t* p = m_pixels.data() + ((size_t)y * m_size.x + x) * 4;
+    return Color(p[0], p[1], p[2], p[3]);
+}
+
+bool SoftwareRasterizer::writePpm(const string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fprintf(file, "P6\n%u %u\n255\n", m_size.x, m_size.y) > 0;
+    vector<uint8_t> row(m_size.x * 3);
+    for (unsigned y = 0; y < m_size.y && ok; ++y) {
+        const uint8_t* pixel = m_pixels.data() + (size_t)y * m_size.x * 4;
+        for (unsigned x = 0; x < m_size.x; ++x, pixel += 4) {
+            memcpy(&row[x * 3], pixel, 3);
+        }
+        ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+    return fclose(file) == 0 && ok;
+}
+
+bool SoftwareRasterizer::writePng(const string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    bool ok = fwrite(signature, 1, sizeof(signature), file) == sizeof(signature);
+
+    // IHDR: 8 bits per channel, color type 6 (RGBA), no interlacing
+    vector<uint8_t> header;
+    putBigEndian(header, m_size.x);
+    putBigEndian(header, m_size.y);
+    const uint8_t format[5] = { 8, 6, 0, 0, 0 };
+    header.insert(header.end(), format, format + 5);
+    ok = ok && writeChunk(file, "IHDR", header);
+
+    // IDAT: a zlib stream of stored deflate blocks over the scanlines, each
+    // led by filter type 0 (none)
+    const size_t rowBytes = (size_t)m_size.x * 4;
+    vector<uint8_t> raw;
+    raw.reserve((rowBytes + 1) * m_size.y);
+    for (unsigned y = 0; y < m_size.y; ++y) {
+        raw.push_back(0);
+        const uint8_t* row = m_pixels.data() + y * rowBytes;
+        raw.insert(raw.end(), row, row + rowBytes);
+    }
+    const size_t MAX_STORED = 65535;
+    vector<uint8_t> data;
+    data.reserve(raw.size() + raw.size() / MAX_STORED * 5 + 16);
+    data.push_back(0x78);   // deflate, 32K window
+    data.push_back(0x01);   // no preset dictionary, fastest; 0x7801 is a multiple of 31
+    size_t offset = 0;
+    do {
+        const size_t block = min(MAX_STORED, raw.size() - offset);
+        const bool last = offset + block == raw.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back((uint8_t)block);
+        data.push_back((uint8_t)(block >> 8));
+        data.push_back((uint8_t)~block);
+        data.push_back((uint8_t)(~block >> 8));
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + block);
+        offset += block;
+    } while (offset < raw.size());
+    putBigEndian(data, adler32(1, raw.data(), raw.size()));
+    ok = ok && writeChunk(file, "IDAT", data);
+
+    ok = ok && writeChunk(file, "IEND", vector<uint8_t>());
+    return fclose(file) == 0 && ok;
+}
+
+bool SoftwareRasterizer::writeImage(const string& path) const
+{
+    const bool png = path.size() >= 4 && (path.compare(path.size() - 4, 4, ".png") == 0 ||
+                                          path.compare(path.size() - 4, 4, ".PNG") == 0);
+    return png ? writePng(path) : writePpm(path);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RenderBackend.h"
+#include "ThreadPool.h"
+
+using namespace sf;
+using namespace std;
+
+///Draws triangles on the CPU into an RGBA framebuffer in memory: no window,
+///no GPU, and the same pixels on every machine and at every thread count.
+///
+///drawTriangles works in two steps.  First every triangle is binned into the
+///TILE x TILE pixel tiles its bounding box touches; the triangles are counted
+///per tile in parallel chunks, and the chunks' counts are laid out tile by
+///tile, chunk by chunk, so each tile's list keeps the triangles in the order
+///they were given.  Then the tiles are rasterized in parallel, each by one
+///thread, which owns its pixels outright: no locks, and the overlaps come out
+///in draw order whichever thread gets there first.
+///
+///A pixel is covered when its center is inside the triangle (edges
+///included) and takes the vertex colors blended by its barycentric weights,
+///which is what SFML's Gouraud shading does with a fan's center and rim
+///colors.  Colors with alpha below 255 are blended over the framebuffer.
+///
+///When every triangle is opaque, a tile is drawn front to back instead and
+///stops once each of its pixels has been written; the picture is the same,
+///but with the overdraw of thousands of overlapping particles most of the
+///triangles binned to a tile are never rasterized.
+class SoftwareRasterizer : public RenderBackend
+{
+public:
+    ///Tile edge in pixels: a 64x64 RGBA tile is 16 KB, well inside L1 + L2
+    static const unsigned TILE = 64;
+
+    explicit SoftwareRasterizer(ThreadPool& pool, Vector2u size = Vector2u(0, 0));
+
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+    ///Resize the framebuffer; its contents are undefined until the next clear
+    void setSize(Vector2u size);
+    Vector2u getSize() const { return m_size; }
+
+    void clear(Color color) override;
+    void drawTriangles(const Vertex* vertices, size_t count) override;
+
+    ///Rows top to bottom, 4 bytes (r, g, b, a) a pixel
+    const uint8_t* getPixels() const { return m_pixels.data(); }
+    Color getPixel(unsigned x, unsigned y) const;
+
+    ///Binary PPM (P6); alpha is dropped
+    bool writePpm(const string& path) const;
+    ///Uncompressed RGBA PNG (stored deflate blocks): bigger than a real
+    ///encoder's, but needs no library and any viewer opens it
+    bool writePng(const string& path) const;
+    ///PNG if path ends in .png, PPM otherwise
+    bool writeImage(const string& path) const;
+
+private:
+    ///Tiles a triangle's bounding box touches, inclusive (x0 > x1 when it
+    ///covers no pixel center)
+    struct TileSpan
+    {
+        uint16_t x0, y0, x1, y1;
+    };
+
+    ///Triangles binned per parallel chunk
+    static const size_t BIN_GRAIN = 4096;
+
+    ThreadPool& m_pool;
+    Vector2u m_size;
+    unsigned m_tilesX = 0;
+    unsigned m_tilesY = 0;
+    vector<uint8_t> m_pixels;
+
+    //binning storage, reused between frames
+    vector<TileSpan> m_spans;       //per triangle
+    vector<uint32_t> m_binCounts;   //chunk-major: [chunk * tiles + tile], then write cursors
+    vector<uint32_t> m_binStart;    //per tile, into m_binned, plus the end
+    vector<uint32_t> m_binned;      //triangle indices grouped by tile
+    vector<uint8_t> m_chunkOpaque;  //per chunk: no vertex with alpha below 255
+    bool m_opaque = true;           //the whole frame is opaque
+
+    void rasterizeTile(unsigned tile, const Vertex* vertices);
+};
@@ -0,0 +1,71 @@
+#include "SpatialGrid.h"
+#include "Profiler.h"
+
+void SpatialGrid::build(const float* x, const float* y, size_t n, float cellSize, ThreadPool& pool)
+{
+    PROFILE_SCOPE("grid_build");
+    m_inverseCell = 1.0f / cellSize;
+
+    // A power of two at least n keeps buckets short on average and the hash a mask
+    size_t buckets = 64;
+    while (buckets < n) {
+        buckets *= 2;
+    }
+    m_mask = (uint32_t)(buckets - 1);
+
+    if (buckets > m_countCapacity) {
+        m_counts.reset(new atomic<uint32_t>[buckets]);
+        m_countCapacity = buckets;
+    }
+    m_bucket.resize(n);
+    m_start.resize(buckets + 1);
+    m_items.resize(n);
+
+    // Count
+    pool.parallelFor(buckets, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            m_counts[b].store(0, memory_order_relaxed);
+        }
+    });
+    pool.parallelFor(n, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t b = bucketOf(cellCoord(x[i]), cellCoord(y[i]));
+            m_bucket[i] = b;
+            m_counts[b].fetch_add(1, memory_order_relaxed);
+        }
+    });
+
+    // Prefix sum: one add per bucket, cheaper than splitting it up
+    uint32_t total = 0;
+    for (size_t b = 0; b < buckets; ++b) {
+        m_start[b] = total;
+        total += m_counts[b].load(memory_order_relaxed);
+    }
+    m_start[buckets] = total;
+
+    // Scatter, counting each bucket back down to zero
+    pool.parallelFor(n, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t b = m_bucket[i];
+            const uint32_t slot = m_counts[b].fetch_sub(1, memory_order_relaxed) - 1;
+            m_items[m_start[b] + slot] = (uint32_t)i;
+        }
+    });
+
+    // The scatter order depends on the threads; buckets are short, so an
+    // insertion sort puts every one back in index order
+    pool.parallelFor(buckets, GRAIN, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            uint32_t* items = m_items.data();
+            for (uint32_t s = m_start[b] + 1; s < m_start[b + 1]; ++s) {
+                const uint32_t item = items[s];
+                uint32_t t = s;
+                while (t > m_start[b] && items[t - 1] > item) {
+                    items[t] = items[t - 1];
+                    --t;
+                }
+                items[t] = item;
+            }
+        }
+    });
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ThreadPool.h"
+
+using namespace std;
+
+///Uniform spatial hash grid for broad-phase neighbour queries.
+///The plane is cut into square cells of cellSize; each cell hashes to one of
+///a power-of-two number of buckets (at least as many as items), so the grid
+///covers any extent without knowing it up front.  build() counting-sorts the
+///items into their buckets in parallel: count, prefix sum, scatter, then sort
+///each bucket by index so the layout never depends on thread timing.
+///
+///Neighbouring cells of a row hash to consecutive buckets, so a 3x3 query is
+///three runs of slots rather than nine lookups.  Items are handed out by
+///slot, their place in bucket order: walking slots in order and keeping
+///per-item data in slot order keeps neighbour queries in cache.
+///
+///With cellSize at least twice the largest radius, every pair that can touch
+///sits in the 3x3 cells around either of them, so forEachNear finds it in
+///O(items per cell) instead of O(n).
+class SpatialGrid
+{
+public:
+    ///Bin items [0, n) by their positions; both arrays must outlive the queries
+    void build(const float* x, const float* y, size_t n, float cellSize, ThreadPool& pool);
+
+    ///Call visit(slot) once for every item in the 3x3 cells around (x, y).
+    ///Items from other cells sharing a bucket come too; filter by distance.
+    template <typename Visit>
+    void forEachNear(float x, float y, const Visit& visit) const
+    {
+        const int32_t cx = cellCoord(x);
+        const int32_t cy = cellCoord(y);
+
+        // The three cells of a row are three consecutive buckets, so each row
+        // is one run of slots
+        uint32_t first[3];
+        uint32_t last[3];
+        bool simple = true;
+        for (int r = 0; r < 3; ++r) {
+            const uint32_t b = bucketOf(cx - 1, cy + r - 1);
+            simple = simple && b + 2 <= m_mask;
+            first[r] = b;
+            last[r] = b + 2;
+        }
+        // Runs that wrap around the table or share a bucket are rare; take
+        // those queries cell by cell so no bucket is walked twice
+        for (int r = 0; r < 3 && simple; ++r) {
+            for (int q = 0; q < r; ++q) {
+                simple = simple && (last[r] < first[q] || first[r] > last[q]);
+            }
+        }
+
+        if (simple) {
+            for (int r = 0; r < 3; ++r) {
+                for (uint32_t s = m_start[first[r]]; s < m_start[last[r] + 1]; ++s) {
+                    visit(s);
+                }
+            }
+            return;
+        }
+
+        uint32_t buckets[9];
+        int count = 0;
+        for (int32_t dy = -1; dy <= 1; ++dy) {
+            for (int32_t dx = -1; dx <= 1; ++dx) {
+                const uint32_t b = bucketOf(cx + dx, cy + dy);
+                bool seen = false;
+                for (int k = 0; k < count; ++k) {
+                    seen = seen || buckets[k] == b;
+                }
+                if (!seen) {
+                    buckets[count++] = b;
+                }
+            }
+        }
+        for (int k = 0; k < count; ++k) {
+            for (uint32_t s = m_start[buckets[k]]; s < m_start[buckets[k] + 1]; ++s) {
+                visit(s);
+            }
+        }
+    }
+
+    ///The item in slot s
+    uint32_t item(size_t s) const { return m_items[s]; }
+
+    size_t size() const { return m_items.size(); }
+    size_t bucketCount() const { return m_mask + 1; }
+
+private:
+    float m_inverseCell = 1.0f;
+    uint32_t m_mask = 0;
+
+    vector<uint32_t> m_bucket;      //bucket of every item
+    vector<uint32_t> m_start;       //first slot of every bucket in m_items, plus the end
+    vector<uint32_t> m_items;       //item indices grouped by bucket, ascending within one
+
+    //per-bucket counters shared by the workers; only ever grows
+    unique_ptr<atomic<uint32_t>[]> m_counts;
+    size_t m_countCapacity = 0;
+
+    ///items handed to each pool task
+    static const size_t GRAIN = 4096;
+
+    int32_t cellCoord(float v) const { return (int32_t)std::floor(v * m_inverseCell); }
+
+    ///Cells of a row go to consecutive buckets; rows are scattered by an odd
+    ///multiplier so the table fills whatever the extent
+    uint32_t bucketOf(int32_t cx, int32_t cy) const
+    {
+        return ((uint32_t)cx + (uint32_t)cy * 0x9E3779B1u) & m_mask;
+    }
+};
@@ -0,0 +1,140 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_queues.emplace_back(new TaskQueue());
+    }
+
+    // Queue 0 belongs to whichever thread calls parallelFor
+    for (unsigned i = 1; i < threadCount; ++i) {
+        m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (thread& t : m_threads) {
+        t.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, size_t grain, BodyRef body)
+{
+    if (n == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    // Nothing to share: run inline on the caller
+    if (m_threads.empty() || n <= grain) {
+        body(0, n);
+        return;
+    }
+
+    lock_guard<mutex> job(m_jobMutex);
+
+    const size_t chunks = (n + grain - 1) / grain;
+    m_body = body;
+    m_pending.store(chunks);
+#ifdef PARTICLES_ALLOC_STATS
+    m_allocSubsystem = AllocStats::current();
+#endif
+
+    // Deal contiguous runs of chunks to each queue so neighbouring chunks
+    // start on the same thread; stealing evens out whatever is left over
+    const size_t queueCount = m_queues.size();
+    const size_t perQueue = (chunks + queueCount - 1) / queueCount;
+    for (size_t q = 0; q < queueCount; ++q) {
+        TaskQueue& queue = *m_queues[q];
+        lock_guard<mutex> lock(queue.lock);
+        queue.tasks.clear();
+        queue.head = 0;
+        const size_t first = q * perQueue;
+        const size_t last = min(chunks, first + perQueue);
+        // Pushed in reverse so the owner, popping from the back, walks forward
+        for (size_t c = last; c > first; --c) {
+            queue.tasks.push_back({ (c - 1) * grain, min(n, c * grain) });
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(m_wakeMutex);
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    runTasks(0);
+
+    unique_lock<mutex> lock(m_doneMutex);
+    m_done.wait(lock, [this] { return m_pending.load() == 0; });
+    m_body = BodyRef{ nullptr, nullptr };
+}
+
+void ThreadPool::workerLoop(unsigned index)
+{
+    unsigned long long seen = 0;
+    for (;;) {
+        {
+            unique_lock<mutex> lock(m_wakeMutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop) {
+                return;
+            }
+            seen = m_generation;
+        }
+        runTasks(index);
+    }
+}
+
+void ThreadPool::runTasks(unsigned index)
+{
+    Task task;
+    while (popOrSteal(index, task)) {
+        // Read after the pop, which orders it after the job was set up
+        ALLOC_SCOPE(m_allocSubsystem);
+        m_body(task.begin, task.end);
+        if (m_pending.fetch_sub(1) == 1) {
+            lock_guard<mutex> lock(m_doneMutex);
+            m_done.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popOrSteal(unsigned index, Task& task)
+{
+    // Own queue first, newest end
+    {
+        TaskQueue& own = *m_queues[index];
+        lock_guard<mutex> lock(own.lock);
+        if (own.tasks.size() > own.head) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Then steal the oldest chunk from the other queues
+    const size_t queueCount = m_queues.size();
+    for (size_t k = 1; k < queueCount; ++k) {
+        TaskQueue& victim = *m_queues[(index + k) % queueCount];
+        lock_guard<mutex> lock(victim.lock);
+        if (victim.tasks.size() > victim.head) {
+            task = victim.tasks[victim.head++];
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "AllocStats.h"
+
+using namespace std;
+
+///Persistent work-stealing thread pool.
+///parallelFor deals the chunks of a range out to per-thread queues; each thread
+///pops from the back of its own queue and steals from the front of the others
+///once it runs dry.  The calling thread works too, so a pool of size 1 starts
+///no threads and runs everything inline (useful for determinism checks).
+class ThreadPool
+{
+public:
+    ///threadCount counts the calling thread; 0 means one per hardware thread
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned getThreadCount() const { return (unsigned)m_queues.size(); }
+
+    ///Split [0, n) into chunks of at most grain items and call body(begin, end)
+    ///once per chunk, spread across the pool.  Returns when every chunk is done.
+    ///Chunks never overlap, so body may write to its own slice without locking.
+    ///body is only referenced, never copied, so passing a lambda allocates nothing.
+    template <typename Body>
+    void parallelFor(size_t n, size_t grain, const Body& body)
+    {
+        parallelFor(n, grain, BodyRef{ &body, [](const void* f, size_t begin, size_t end) {
+            (*static_cast<const Body*>(f))(begin, end);
+        } });
+    }
+
+private:
+    ///Non-owning reference to a parallelFor body.  Unlike std::function it
+    ///never copies the callable, so a capturing lambda costs no heap allocation.
+    struct BodyRef
+    {
+        const void* object;
+        void (*call)(const void*, size_t, size_t);
+
+        void operator()(size_t begin, size_t end) const { call(object, begin, end); }
+    };
+
+    void parallelFor(size_t n, size_t grain, BodyRef body);
+
+    struct Task
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    ///One queue per thread.  The owner takes from the back, thieves from m_head.
+    struct TaskQueue
+    {
+        mutex lock;
+        vector<Task> tasks;
+        size_t head = 0;
+    };
+
+    vector<unique_ptr<TaskQueue>> m_queues;
+    vector<thread> m_threads;
+
+    //the job currently running
+    mutex m_jobMutex;
+    BodyRef m_body{ nullptr, nullptr };
+    //the caller's ALLOC_SCOPE, which the workers run the job under; only set
+    //in an ALLOC_STATS build, but always there so the layout never depends on it
+    AllocStats::Subsystem m_allocSubsystem = AllocStats::OTHER;
+    atomic<size_t> m_pending{0};
+
+    //wakes workers when a job starts
+    mutex m_wakeMutex;
+    condition_variable m_wake;
+    unsigned long long m_generation = 0;
+    bool m_stop = false;
+
+    //wakes the caller when the last chunk finishes
+    mutex m_doneMutex;
+    condition_variable m_done;
+
+    void workerLoop(unsigned index);
+    void runTasks(unsigned index);
+    bool popOrSteal(unsigned index, Task& task);
+};
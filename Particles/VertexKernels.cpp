@@ -0,0 +1,308 @@
+#include "VertexKernels.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define VERTEX_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace VertexKernels;
+
+namespace
+{
+    typedef void (*TransformFn)(const double*, double*, size_t, const ParticleTransform&);
+    typedef void (*TransformFnF)(const float*, float*, size_t, const ParticleTransform&);
+
+    // The transform rounded once to float, for the float kernels
+    struct TransformF
+    {
+        float a;
+        float b;
+        float pivotX;
+        float pivotY;
+        float destX;
+        float destY;
+
+        explicit TransformF(const ParticleTransform& t)
+            : a((float)t.a), b((float)t.b), pivotX((float)t.pivotX), pivotY((float)t.pivotY),
+              destX((float)t.destX), destY((float)t.destY) {}
+    };
+
+    // Reference path, also used for the tail the SSE2 float loop leaves over
+    void transformScalar(const double* src, double* dst, size_t count, const ParticleTransform& t)
+    {
+        for (size_t j = 0; j < count; ++j) {
+            double x = src[2 * j] - t.pivotX;
+            double y = src[2 * j + 1] - t.pivotY;
+            dst[2 * j] = t.destX + (t.a * x - t.b * y);
+            dst[2 * j + 1] = t.destY + (t.b * x + t.a * y);
+        }
+    }
+
+    void transformScalarF(const float* src, float* dst, size_t count, const ParticleTransform& transform)
+    {
+        const TransformF t(transform);
+        for (size_t j = 0; j < count; ++j) {
+            float x = src[2 * j] - t.pivotX;
+            float y = src[2 * j + 1] - t.pivotY;
+            dst[2 * j] = t.destX + (t.a * x - t.b * y);
+            dst[2 * j + 1] = t.destY + (t.b * x + t.a * y);
+        }
+    }
+
+#ifdef VERTEX_KERNELS_X86
+    // One (x,y) vertex per register.  With d = p - pivot:
+    //   p' = dest + (a, a) * (dx, dy) + (-b, b) * (dy, dx)
+    void transformSSE2(const double* src, double* dst, size_t count, const ParticleTransform& t)
+    {
+        const __m128d pivot = _mm_set_pd(t.pivotY, t.pivotX);
+        const __m128d dest = _mm_set_pd(t.destY, t.destX);
+        const __m128d a = _mm_set1_pd(t.a);
+        const __m128d b = _mm_set_pd(t.b, -t.b);
+        for (size_t j = 0; j < count; ++j) {
+            __m128d d = _mm_sub_pd(_mm_loadu_pd(src + 2 * j), pivot);
+            __m128d swapped = _mm_shuffle_pd(d, d, 1);
+            __m128d r = _mm_add_pd(_mm_mul_pd(d, a), _mm_mul_pd(swapped, b));
+            _mm_storeu_pd(dst + 2 * j, _mm_add_pd(r, dest));
+        }
+    }
+
+    // Two vertices per register, same algebra as the SSE2 path.  The odd
+    // vertex goes through a masked load/store too: calling the non-VEX scalar
+    // code straight after 256-bit work costs an AVX-SSE transition that made
+    // odd rings several times slower than the scalar path.
+    __attribute__((target("avx2,fma")))
+    void transformAVX2(const double* src, double* dst, size_t count, const ParticleTransform& t)
+    {
+        const __m256d pivot = _mm256_set_pd(t.pivotY, t.pivotX, t.pivotY, t.pivotX);
+        const __m256d dest = _mm256_set_pd(t.destY, t.destX, t.destY, t.destX);
+        const __m256d a = _mm256_set1_pd(t.a);
+        const __m256d b = _mm256_set_pd(t.b, -t.b, t.b, -t.b);
+        size_t j = 0;
+        for (; j + 2 <= count; j += 2) {
+            __m256d d = _mm256_sub_pd(_mm256_loadu_pd(src + 2 * j), pivot);
+            __m256d swapped = _mm256_permute_pd(d, 0x5);
+            __m256d r = _mm256_fmadd_pd(d, a, _mm256_mul_pd(swapped, b));
+            _mm256_storeu_pd(dst + 2 * j, _mm256_add_pd(r, dest));
+        }
+        if (j < count) {
+            const __m256i mask = _mm256_set_epi64x(0, 0, -1, -1);
+            __m256d d = _mm256_sub_pd(_mm256_maskload_pd(src + 2 * j, mask), pivot);
+            __m256d swapped = _mm256_permute_pd(d, 0x5);
+            __m256d r = _mm256_fmadd_pd(d, a, _mm256_mul_pd(swapped, b));
+            _mm256_maskstore_pd(dst + 2 * j, mask, _mm256_add_pd(r, dest));
+        }
+    }
+
+    // Four vertices per register; the tail uses a masked load/store
+    __attribute__((target("avx512f")))
+    void transformAVX512(const double* src, double* dst, size_t count, const ParticleTransform& t)
+    {
+        const __m512d pivot = _mm512_set_pd(t.pivotY, t.pivotX, t.pivotY, t.pivotX,
+                                            t.pivotY, t.pivotX, t.pivotY, t.pivotX);
+        const __m512d dest = _mm512_set_pd(t.destY, t.destX, t.destY, t.destX,
+                                           t.destY, t.destX, t.destY, t.destX);
+        const __m512d a = _mm512_set1_pd(t.a);
+        const __m512d b = _mm512_set_pd(t.b, -t.b, t.b, -t.b, t.b, -t.b, t.b, -t.b);
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4) {
+            __m512d d = _mm512_sub_pd(_mm512_loadu_pd(src + 2 * j), pivot);
+            __m512d swapped = _mm512_shuffle_pd(d, d, 0x55);
+            __m512d r = _mm512_fmadd_pd(d, a, _mm512_mul_pd(swapped, b));
+            _mm512_storeu_pd(dst + 2 * j, _mm512_add_pd(r, dest));
+        }
+        if (j < count) {
+            __mmask8 mask = (__mmask8)((1u << (2 * (count - j))) - 1);
+            __m512d d = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, src + 2 * j), pivot);
+            __m512d swapped = _mm512_shuffle_pd(d, d, 0x55);
+            __m512d r = _mm512_fmadd_pd(d, a, _mm512_mul_pd(swapped, b));
+            _mm512_mask_storeu_pd(dst + 2 * j, mask, _mm512_add_pd(r, dest));
+        }
+    }
+
+    // Float versions: twice the vertices per register.  Shuffle 0xB1 swaps
+    // x and y inside every (x,y) pair.
+    void transformSSE2F(const float* src, float* dst, size_t count, const ParticleTransform& transform)
+    {
+        const TransformF t(transform);
+        const __m128 pivot = _mm_set_ps(t.pivotY, t.pivotX, t.pivotY, t.pivotX);
+        const __m128 dest = _mm_set_ps(t.destY, t.destX, t.destY, t.destX);
+        const __m128 a = _mm_set1_ps(t.a);
+        const __m128 b = _mm_set_ps(t.b, -t.b, t.b, -t.b);
+        size_t j = 0;
+        for (; j + 2 <= count; j += 2) {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(src + 2 * j), pivot);
+            __m128 swapped = _mm_shuffle_ps(d, d, 0xB1);
+            __m128 r = _mm_add_ps(_mm_mul_ps(d, a), _mm_mul_ps(swapped, b));
+            _mm_storeu_ps(dst + 2 * j, _mm_add_ps(r, dest));
+        }
+        transformScalarF(src + 2 * j, dst + 2 * j, count - j, transform);
+    }
+
+    // Up to three vertices left over, masked like the double version's
+    __attribute__((target("avx2,fma")))
+    void transformAVX2F(const float* src, float* dst, size_t count, const ParticleTransform& transform)
+    {
+        const TransformF t(transform);
+        const __m256 pivot = _mm256_set_ps(t.pivotY, t.pivotX, t.pivotY, t.pivotX, t.pivotY, t.pivotX, t.pivotY, t.pivotX);
+        const __m256 dest = _mm256_set_ps(t.destY, t.destX, t.destY, t.destX, t.destY, t.destX, t.destY, t.destX);
+        const __m256 a = _mm256_set1_ps(t.a);
+        const __m256 b = _mm256_set_ps(t.b, -t.b, t.b, -t.b, t.b, -t.b, t.b, -t.b);
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(src + 2 * j), pivot);
+            __m256 swapped = _mm256_permute_ps(d, 0xB1);
+            __m256 r = _mm256_fmadd_ps(d, a, _mm256_mul_ps(swapped, b));
+            _mm256_storeu_ps(dst + 2 * j, _mm256_add_ps(r, dest));
+        }
+        if (j < count) {
+            // Lanes [0, 2 * (count - j)) hold the remaining x and y values
+            const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(2 * (count - j))),
+                                                    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            __m256 d = _mm256_sub_ps(_mm256_maskload_ps(src + 2 * j, mask), pivot);
+            __m256 swapped = _mm256_permute_ps(d, 0xB1);
+            __m256 r = _mm256_fmadd_ps(d, a, _mm256_mul_ps(swapped, b));
+            _mm256_maskstore_ps(dst + 2 * j, mask, _mm256_add_ps(r, dest));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void transformAVX512F(const float* src, float* dst, size_t count, const ParticleTransform& transform)
+    {
+        const TransformF t(transform);
+        // Odd lanes (mask 0xAAAA) hold y, even lanes x
+        const __m512 pivot = _mm512_mask_blend_ps((__mmask16)0xAAAA, _mm512_set1_ps(t.pivotX), _mm512_set1_ps(t.pivotY));
+        const __m512 dest = _mm512_mask_blend_ps((__mmask16)0xAAAA, _mm512_set1_ps(t.destX), _mm512_set1_ps(t.destY));
+        const __m512 a = _mm512_set1_ps(t.a);
+        const __m512 b = _mm512_mask_blend_ps((__mmask16)0xAAAA, _mm512_set1_ps(-t.b), _mm512_set1_ps(t.b));
+        size_t j = 0;
+        for (; j + 8 <= count; j += 8) {
+            __m512 d = _mm512_sub_ps(_mm512_loadu_ps(src + 2 * j), pivot);
+            __m512 swapped = _mm512_shuffle_ps(d, d, 0xB1);
+            __m512 r = _mm512_fmadd_ps(d, a, _mm512_mul_ps(swapped, b));
+            _mm512_storeu_ps(dst + 2 * j, _mm512_add_ps(r, dest));
+        }
+        if (j < count) {
+            __mmask16 mask = (__mmask16)((1u << (2 * (count - j))) - 1);
+            __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, src + 2 * j), pivot);
+            __m512 swapped = _mm512_shuffle_ps(d, d, 0xB1);
+            __m512 r = _mm512_fmadd_ps(d, a, _mm512_mul_ps(swapped, b));
+            _mm512_mask_storeu_ps(dst + 2 * j, mask, _mm512_add_ps(r, dest));
+        }
+    }
+#endif
+
+    TransformFn functionFor(InstructionSet isa)
+    {
+        switch (isa) {
+#ifdef VERTEX_KERNELS_X86
+        case InstructionSet::AVX512: return transformAVX512;
+        case InstructionSet::AVX2: return transformAVX2;
+        case InstructionSet::SSE2: return transformSSE2;
+#endif
+        default: return transformScalar;
+        }
+    }
+
+    TransformFnF floatFunctionFor(InstructionSet isa)
+    {
+        switch (isa) {
+#ifdef VERTEX_KERNELS_X86
+        case InstructionSet::AVX512: return transformAVX512F;
+        case InstructionSet::AVX2: return transformAVX2F;
+        case InstructionSet::SSE2: return transformSSE2F;
+#endif
+        default: return transformScalarF;
+        }
+    }
+
+    bool supported(InstructionSet isa)
+    {
+#ifdef VERTEX_KERNELS_X86
+        __builtin_cpu_init();
+        switch (isa) {
+        case InstructionSet::AVX512: return __builtin_cpu_supports("avx512f");
+        case InstructionSet::AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case InstructionSet::SSE2: return true; // baseline on x86-64
+        default: return true;
+        }
+#else
+        return isa == InstructionSet::Scalar;
+#endif
+    }
+
+    // PARTICLES_SIMD=scalar|sse2|avx2|avx512 overrides the detected set
+    InstructionSet initialInstructionSet()
+    {
+        InstructionSet isa = detectInstructionSet();
+        const char* env = std::getenv("PARTICLES_SIMD");
+        if (env != nullptr) {
+            const InstructionSet all[] = { InstructionSet::Scalar, InstructionSet::SSE2,
+                                           InstructionSet::AVX2, InstructionSet::AVX512 };
+            for (InstructionSet candidate : all) {
+                if (std::strcmp(env, instructionSetName(candidate)) == 0 && supported(candidate)) {
+                    isa = candidate;
+                }
+            }
+        }
+        return isa;
+    }
+
+    InstructionSet g_active = initialInstructionSet();
+    TransformFn g_transform = functionFor(g_active);
+    TransformFnF g_transformF = floatFunctionFor(g_active);
+}
+
+ParticleTransform VertexKernels::makeTransform(double centerX, double centerY, double theta, double s, double dx, double dy)
+{
+    ParticleTransform t;
+    t.a = s * std::cos(theta);
+    t.b = s * std::sin(theta);
+    t.pivotX = centerX;
+    t.pivotY = centerY;
+    t.destX = centerX + dx;
+    t.destY = centerY + dy;
+    return t;
+}
+
+void VertexKernels::transformVertices(const double* src, double* dst, size_t count, const ParticleTransform& t)
+{
+    g_transform(src, dst, count, t);
+}
+
+void VertexKernels::transformVertices(const float* src, float* dst, size_t count, const ParticleTransform& t)
+{
+    g_transformF(src, dst, count, t);
+}
+
+InstructionSet VertexKernels::detectInstructionSet()
+{
+    if (supported(InstructionSet::AVX512)) return InstructionSet::AVX512;
+    if (supported(InstructionSet::AVX2)) return InstructionSet::AVX2;
+    if (supported(InstructionSet::SSE2)) return InstructionSet::SSE2;
+    return InstructionSet::Scalar;
+}
+
+InstructionSet VertexKernels::activeInstructionSet()
+{
+    return g_active;
+}
+
+void VertexKernels::setInstructionSet(InstructionSet isa)
+{
+    g_active = supported(isa) ? isa : detectInstructionSet();
+    g_transform = functionFor(g_active);
+    g_transformF = floatFunctionFor(g_active);
+}
+
+const char* VertexKernels::instructionSetName(InstructionSet isa)
+{
+    switch (isa) {
+    case InstructionSet::AVX512: return "avx512";
+    case InstructionSet::AVX2: return "avx2";
+    case InstructionSet::SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+
+///Batched vertex transforms for particle rings stored as interleaved (x,y) pairs
+///(the layout of a 2xN Matrix and of the ParticleSystem vertex buffer).
+///The SIMD path is picked once at runtime from what the CPU supports.
+///Every kernel comes in double and float flavours so either Real works;
+///the float ones fit twice as many vertices in a register.
+namespace VertexKernels
+{
+    ///Rotate by theta and scale by s about a pivot, then move the pivot to dest:
+    ///   p' = dest + s * R(theta) * (p - pivot)
+    ///a = s * cos(theta), b = s * sin(theta)
+    struct ParticleTransform
+    {
+        double a;
+        double b;
+        double pivotX;
+        double pivotY;
+        double destX;
+        double destY;
+    };
+
+    ///Build the transform Particle::update applies in one frame:
+    ///rotate(theta) and scale(s) about the center, then translate(dx, dy)
+    ParticleTransform makeTransform(double centerX, double centerY, double theta, double s, double dx, double dy);
+
+    enum class InstructionSet { Scalar, SSE2, AVX2, AVX512 };
+
+    ///Transform count vertices from src into dst.
+    ///src == dst works in place; dst may also sit before src (used while compacting)
+    void transformVertices(const double* src, double* dst, size_t count, const ParticleTransform& t);
+    void transformVertices(const float* src, float* dst, size_t count, const ParticleTransform& t);
+
+    ///Best instruction set this CPU supports (and this build was compiled for)
+    InstructionSet detectInstructionSet();
+
+    ///Instruction set transformVertices currently dispatches to
+    InstructionSet activeInstructionSet();
+
+    ///Force a specific path (e.g. Scalar for determinism checks).
+    ///Falls back to the best supported set if the CPU lacks the requested one.
+    void setInstructionSet(InstructionSet isa);
+
+    const char* instructionSetName(InstructionSet isa);
+}
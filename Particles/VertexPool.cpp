@@ -0,0 +1,60 @@
+#include "VertexPool.h"
+
+uint32_t VertexPool::allocate(int numPoints)
+{
+    if ((size_t)numPoints >= m_freeLists.size() || m_freeLists[numPoints].empty()) {
+        carveSlab(numPoints);
+    }
+
+    vector<uint32_t>& freeList = m_freeLists[numPoints];
+    uint32_t offset = freeList.back();
+    freeList.pop_back();
+    return offset;
+}
+
+void VertexPool::release(uint32_t offset, int numPoints)
+{
+    m_freeLists[numPoints].push_back(offset);
+}
+
+void VertexPool::reserve(int numPoints, size_t count)
+{
+    if ((size_t)numPoints >= m_freeLists.size()) {
+        m_freeLists.resize(numPoints + 1);
+    }
+    while (m_freeLists[numPoints].size() < count) {
+        carveSlab(numPoints);
+    }
+}
+
+void VertexPool::clear()
+{
+    // Hand every slab's rings back to its free list
+    for (vector<uint32_t>& freeList : m_freeLists) {
+        freeList.clear();
+    }
+    for (const pair<int, uint32_t>& slab : m_slabs) {
+        vector<uint32_t>& freeList = m_freeLists[slab.first];
+        for (size_t b = m_slabBlocks; b > 0; --b) {
+            freeList.push_back(slab.second + (uint32_t)((b - 1) * slab.first));
+        }
+    }
+}
+
+void VertexPool::carveSlab(int numPoints)
+{
+    if ((size_t)numPoints >= m_freeLists.size()) {
+        m_freeLists.resize(numPoints + 1);
+    }
+
+    const uint32_t first = (uint32_t)(m_storage.size() / 2);
+    m_storage.resize(m_storage.size() + 2 * m_slabBlocks * (size_t)numPoints);
+    m_slabs.push_back({ numPoints, first });
+
+    // Pushed last-to-first so allocation walks the slab in address order
+    vector<uint32_t>& freeList = m_freeLists[numPoints];
+    freeList.reserve(freeList.size() + m_slabBlocks);
+    for (size_t b = m_slabBlocks; b > 0; --b) {
+        freeList.push_back(first + (uint32_t)((b - 1) * numPoints));
+    }
+}
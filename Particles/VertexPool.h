@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Precision.h"
+
+using namespace std;
+
+///Slab allocator for particle vertex rings.
+///Every ring of n vertices (2n Reals, interleaved (x,y)) comes from the free
+///list for size n.  When a list runs dry a whole slab of slabBlocks rings is
+///carved off the end of the backing storage at once, and released rings go
+///back on their list, so once the pool has seen the peak particle count,
+///spawning and retiring particles does no heap allocation.
+///
+///Rings are addressed by vertex offset into data(), not by pointer, so offsets
+///stay valid when the backing storage grows.
+class VertexPool
+{
+public:
+    ///rings carved per slab unless the constructor says otherwise
+    static const size_t SLAB_BLOCKS = 256;
+
+    explicit VertexPool(size_t slabBlocks = SLAB_BLOCKS) : m_slabBlocks(slabBlocks) {}
+
+    ///Offset (in vertices) of a ring of numPoints vertices
+    uint32_t allocate(int numPoints);
+
+    ///Return a ring obtained from allocate(numPoints)
+    void release(uint32_t offset, int numPoints);
+
+    ///Pre-carve enough slabs that count rings of numPoints need no new storage
+    void reserve(int numPoints, size_t count);
+
+    Real* data() { return m_storage.data(); }
+    const Real* data() const { return m_storage.data(); }
+
+    ///vertices carved into slabs so far (live + free)
+    size_t capacity() const { return m_storage.size() / 2; }
+
+    ///Drop every ring; slabs are kept
+    void clear();
+
+private:
+    size_t m_slabBlocks;
+    vector<Real> m_storage;
+
+    ///m_freeLists[n]: offsets of free rings of n vertices
+    vector<vector<uint32_t>> m_freeLists;
+
+    ///every slab carved so far: (numPoints, first offset)
+    vector<pair<int, uint32_t>> m_slabs;
+
+    void carveSlab(int numPoints);
+};
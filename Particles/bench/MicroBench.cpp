@@ -0,0 +1,698 @@
+// Microbenchmarks for the Matrices and Particle kernels.
+// Built by `make bench`; prints one CSV row per benchmark so runs from
+// different versions can be diffed or plotted:
+//   benchmark,size,isa,iterations,ns_per_op,ns_per_vertex
+//
+// Self-checks of the optimized kernels against plain reference code run
+// first; if one fails, it says so on stderr and nothing is timed (exit 1).
+//
+// usage: MicroBench.out [--min-time seconds] [--filter substring] [--out file.csv]
+#include "../FixedMatrix.h"
+#include "../Matrices.h"
+#include "../Particle.h"
+#include "../ParticleSystem.h"
+#include "../Profiler.h"
+#include "../Random.h"
+#include "../Snapshot.h"
+#include "../SpatialGrid.h"
+#include "../SoftwareRasterizer.h"
+#include "../ThreadPool.h"
+#include "../VertexKernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Matrices;
+
+namespace
+{
+    typedef chrono::steady_clock BenchClock;
+
+    double g_minTime = 0.2;
+    const char* g_filter = nullptr;
+    FILE* g_out = stdout;
+    Rng g_rng(42);
+
+    // Keeps the optimizer from discarding results the benchmark never reads
+    template <typename T>
+    inline void doNotOptimize(const T& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Doubles the iteration count until one batch runs for at least g_minTime
+    void measure(const string& name, int size, const function<void(size_t)>& body)
+    {
+        if (g_filter != nullptr && name.find(g_filter) == string::npos) {
+            return;
+        }
+
+        body(1); // warm caches and lazy initialization
+        size_t iterations = 1;
+        double seconds = 0.0;
+        for (;;) {
+            BenchClock::time_point start = BenchClock::now();
+            body(iterations);
+            seconds = chrono::duration<double>(BenchClock::now() - start).count();
+            if (seconds >= g_minTime || iterations >= ((size_t)1 << 40)) {
+                break;
+            }
+            iterations *= (seconds > 0.0 && seconds < g_minTime / 8) ? 8 : 2;
+        }
+
+        double nsPerOp = seconds * 1e9 / iterations;
+        fprintf(g_out, "%s,%d,%s,%zu,%.3f,%.4f\n", name.c_str(), size,
+                VertexKernels::instructionSetName(VertexKernels::activeInstructionSet()),
+                iterations, nsPerOp, size > 0 ? nsPerOp / size : 0.0);
+        fflush(g_out);
+    }
+
+    Matrix randomShape(int cols)
+    {
+        Matrix m(2, cols);
+        for (int j = 0; j < cols; ++j) {
+            m(0, j) = g_rng.uniform(-100.0, 100.0);
+            m(1, j) = g_rng.uniform(-100.0, 100.0);
+        }
+        return m;
+    }
+
+    void matrixBenchmarks(int n)
+    {
+        Matrix a = randomShape(n);
+        Matrix b = randomShape(n);
+        RotationMatrix r(0.3);
+
+        measure("matrix_mul_2x2_2xN", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                Matrix c = r * a;
+                doNotOptimize(c(0, 0));
+            }
+        });
+        Matrix rotated(2, n);
+        measure("matrix_mul_2x2_2xN_into", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                multiply(r, a, rotated);
+                doNotOptimize(rotated(0, 0));
+            }
+        });
+        measure("matrix_add_2xN", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                Matrix c = a + b;
+                doNotOptimize(c(0, 0));
+            }
+        });
+        measure("translation_matrix_ctor", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                TranslationMatrix t(1.5, -2.5, n);
+                doNotOptimize(t(0, 0));
+            }
+        });
+
+        // T + R * (S * A): dynamic temporaries vs one fused expression pass
+        ScalingMatrix s(0.999);
+        TranslationMatrix t(1.5, -2.5, n);
+        measure("matrix_chain_T_R_S_A", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                a = t + r * (s * a);
+            }
+            doNotOptimize(a(0, 0));
+        });
+        measure("fixed_expr_T_R_S_A", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                assign(a, translation((Real)1.5, (Real)-2.5) + rotation((Real)0.3) * (scaling((Real)0.999) * columns(a)));
+            }
+            doNotOptimize(a(0, 0));
+        });
+    }
+
+    // Self-checks, run before anything is timed so a benchmark never reports
+    // the speed of a wrong answer.  Each prints what failed to stderr.
+
+    Matrix randomMatrix(int rows, int cols)
+    {
+        Matrix m(rows, cols);
+        for (int j = 0; j < cols; ++j) {
+            for (int i = 0; i < rows; ++i) {
+                m(i, j) = g_rng.uniform(-1.0, 1.0);
+            }
+        }
+        return m;
+    }
+
+    // The textbook triple loop, accumulated in double
+    Matrix naiveProduct(const Matrix& a, const Matrix& b)
+    {
+        Matrix c(a.getRows(), b.getCols());
+        for (int i = 0; i < a.getRows(); ++i) {
+            for (int j = 0; j < b.getCols(); ++j) {
+                double sum = 0.0;
+                for (int p = 0; p < a.getCols(); ++p) {
+                    sum += (double)a(i, p) * b(p, j);
+                }
+                c(i, j) = sum;
+            }
+        }
+        return c;
+    }
+
+    bool checkProduct(const Matrix& got, const Matrix& want, const char* what, int m, int k, int n)
+    {
+        if (got == want) {
+            return true;
+        }
+        fprintf(stderr, "MicroBench: self-check failed: %s, %d x %d x %d\n", what, m, k, n);
+        return false;
+    }
+
+    // Every vertex kernel the CPU has against the scalar one, for every tail
+    // length, in place and into a separate buffer
+    template <typename T>
+    bool checkVertexKernels(const char* type)
+    {
+        const VertexKernels::ParticleTransform t = VertexKernels::makeTransform(1.0, 2.0, 0.7, 0.9, 0.5, -0.5);
+        const VertexKernels::InstructionSet best = VertexKernels::detectInstructionSet();
+        const VertexKernels::InstructionSet all[] = { VertexKernels::InstructionSet::SSE2,
+                                                      VertexKernels::InstructionSet::AVX2,
+                                                      VertexKernels::InstructionSet::AVX512 };
+        bool ok = true;
+        for (size_t n = 0; n <= 40; ++n) {
+            // One guard value past the end must survive the masked tails
+            vector<T> src(2 * n + 1);
+            for (T& v : src) {
+                v = (T)g_rng.uniform(-100.0, 100.0);
+            }
+            vector<T> want(src);
+            VertexKernels::setInstructionSet(VertexKernels::InstructionSet::Scalar);
+            VertexKernels::transformVertices(src.data(), want.data(), n, t);
+            for (VertexKernels::InstructionSet isa : all) {
+                if (isa > best) {
+                    continue;
+                }
+                VertexKernels::setInstructionSet(isa);
+                vector<T> copied(src);
+                vector<T> inPlace(src);
+                VertexKernels::transformVertices(src.data(), copied.data(), n, t);
+                VertexKernels::transformVertices(inPlace.data(), inPlace.data(), n, t);
+                for (size_t k = 0; k <= 2 * n; ++k) {
+                    const double tolerance = 1e-4 * (1.0 + fabs((double)want[k]));
+                    if (fabs((double)copied[k] - want[k]) > tolerance || fabs((double)inPlace[k] - want[k]) > tolerance) {
+                        fprintf(stderr, "MicroBench: self-check failed: %s %s vertex kernel, %zu vertices, value %zu\n",
+                                VertexKernels::instructionSetName(isa), type, n, k);
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+        }
+        VertexKernels::setInstructionSet(best);
+        return ok;
+    }
+
+    // multiply and operator* against naiveProduct, through both kernels,
+    // with and without a pool
+    bool checkMultiply()
+    {
+        // m x k x n.  Gemm blocks with KC = 256, MC = 96 (192 in float) and
+        // NC = 960, in MR x NR tiles of 8 x 6 (16 x 6 in float), and leaves
+        // products under 12^3 to a plain loop: the sizes sit on either side
+        // of each.  The last one is big enough for the pool.
+        const int shapes[][3] = {
+            { 1, 1, 1 }, { 5, 0, 4 }, { 2, 2, 7 },
+            { 11, 11, 11 }, { 12, 12, 12 }, { 13, 13, 13 }, { 17, 23, 7 },
+            { 95, 255, 13 }, { 96, 256, 12 }, { 97, 257, 14 },
+            { 191, 300, 5 }, { 192, 512, 6 }, { 193, 513, 31 },
+            { 9, 17, 959 }, { 8, 16, 960 }, { 10, 20, 961 },
+            { 300, 257, 301 }
+        };
+        // More than one thread, so the pooled path runs even on one core
+        ThreadPool pool(4);
+        const VertexKernels::InstructionSet best = VertexKernels::detectInstructionSet();
+        const VertexKernels::InstructionSet kernels[] = { VertexKernels::InstructionSet::Scalar, best };
+        bool ok = true;
+
+        for (const auto& shape : shapes) {
+            const int m = shape[0], k = shape[1], n = shape[2];
+            const Matrix a = randomMatrix(m, k);
+            const Matrix b = randomMatrix(k, n);
+            const Matrix want = naiveProduct(a, b);
+            for (VertexKernels::InstructionSet isa : kernels) {
+                VertexKernels::setInstructionSet(isa);
+                ok = checkProduct(a * b, want, "operator*", m, k, n) && ok;
+                for (ThreadPool* with : { (ThreadPool*)nullptr, &pool }) {
+                    // Stale contents must be overwritten, not added to
+                    Matrix out(m, n);
+                    for (int i = 0; i < out.size(); ++i) {
+                        out.data()[i] = 1e6;
+                    }
+                    multiply(a, b, out, with);
+                    ok = checkProduct(out, want, with != nullptr ? "multiply, pooled" : "multiply", m, k, n) && ok;
+                }
+            }
+        }
+
+        // out aliasing an operand
+        for (VertexKernels::InstructionSet isa : kernels) {
+            VertexKernels::setInstructionSet(isa);
+            Matrix square = randomMatrix(150, 150);
+            Matrix want = naiveProduct(square, square);
+            multiply(square, square, square, &pool);
+            ok = checkProduct(square, want, "multiply, out is a and b", 150, 150, 150) && ok;
+
+            Matrix a = randomMatrix(120, 80);
+            const Matrix b = randomMatrix(80, 80);
+            want = naiveProduct(a, b);
+            multiply(a, b, a);
+            ok = checkProduct(a, want, "multiply, out is a", 120, 80, 80) && ok;
+
+            const Matrix left = randomMatrix(80, 80);
+            Matrix right = randomMatrix(80, 50);
+            want = naiveProduct(left, right);
+            multiply(left, right, right);
+            ok = checkProduct(right, want, "multiply, out is b", 80, 80, 50) && ok;
+
+            const RotationMatrix r(0.3);
+            Matrix points = randomMatrix(2, 50);
+            want = naiveProduct(r, points);
+            multiply(r, points, points);
+            ok = checkProduct(points, want, "multiply 2x2, out is b", 2, 2, 50) && ok;
+
+            Matrix r2 = randomMatrix(2, 2);
+            want = naiveProduct(r2, r2);
+            multiply(r2, r2, r2);
+            ok = checkProduct(r2, want, "multiply 2x2, out is a and b", 2, 2, 2) && ok;
+        }
+
+        // Mismatched sizes throw
+        for (int bad = 0; bad < 2; ++bad) {
+            try {
+                Matrix out(3, bad == 0 ? 2 : 3);
+                multiply(randomMatrix(3, 4), randomMatrix(bad == 0 ? 3 : 4, 2), out);
+                fprintf(stderr, "MicroBench: self-check failed: multiply accepted mismatched sizes\n");
+                ok = false;
+            }
+            catch (const runtime_error&) {
+            }
+        }
+
+        VertexKernels::setInstructionSet(best);
+        return ok;
+    }
+
+    // SpatialGrid::forEachNear visits everything in the 3x3 cells around a
+    // point exactly once, and anything else at most once, on cells picked to
+    // share buckets and to make the row runs wrap around the table
+    bool checkGrid()
+    {
+        const size_t n = 3000;
+        const int32_t buckets = 4096;  // what build picks for n items
+        const float cell = 16.0f;
+        vector<float> x(n);
+        vector<float> y(n);
+        vector<int32_t> cx(n);
+        vector<int32_t> cy(n);
+        for (size_t i = 0; i < n; ++i) {
+            if (i % 2 == 0) {
+                // A crowd around the origin, where cell -1 is the last bucket
+                cx[i] = g_rng.range(-20, 20);
+                cy[i] = g_rng.range(-20, 20);
+            }
+            else {
+                // Cells a whole table apart land in the same buckets
+                cx[i] = g_rng.range(-2, 2) + g_rng.range(-2, 2) * buckets;
+                cy[i] = g_rng.range(-1, 1);
+            }
+            x[i] = ((float)cx[i] + g_rng.uniform(0.05f, 0.95f)) * cell;
+            y[i] = ((float)cy[i] + g_rng.uniform(0.05f, 0.95f)) * cell;
+        }
+
+        ThreadPool pool(4);
+        SpatialGrid grid;
+        grid.build(x.data(), y.data(), n, cell, pool);
+        if (grid.bucketCount() != (size_t)buckets) {
+            fprintf(stderr, "MicroBench: self-check failed: grid has %zu buckets, expected %d\n",
+                    grid.bucketCount(), buckets);
+            return false;
+        }
+
+        vector<int> visits(n);
+        for (size_t i = 0; i < n; ++i) {
+            fill(visits.begin(), visits.end(), 0);
+            grid.forEachNear(x[i], y[i], [&](uint32_t slot) { ++visits[grid.item(slot)]; });
+            for (size_t j = 0; j < n; ++j) {
+                const bool near = abs(cx[j] - cx[i]) <= 1 && abs(cy[j] - cy[i]) <= 1;
+                if (visits[j] > 1 || (near && visits[j] == 0)) {
+                    fprintf(stderr, "MicroBench: self-check failed: grid query around cell (%d, %d) visited "
+                            "cell (%d, %d) %d times\n", cx[i], cy[i], cx[j], cy[j], visits[j]);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // ParticleSystem::collide against the same contact rule applied to every
+    // pair of particles
+    bool checkCollisions()
+    {
+        // Five crowds of 600, each spawned from two points 120 apart so half
+        // of it runs into the other half (one spawn only spreads out).  The
+        // grid gets 4096 buckets, so crowds 4096 cells apart share them, and
+        // the crowd around x = 0 sits where the row runs wrap around the table
+        const float cell = (float)(2.0 * ParticleSystem::MAX_RADIUS);
+        const float table = 4096.0f * cell;
+        const Vector2f centers[] = { Vector2f(-80.0f, 0.0f), Vector2f(table - 80.0f, 0.0f),
+                                     Vector2f(300.0f, 50.0f), Vector2f(2.0f * table + 300.0f, 50.0f),
+                                     Vector2f(1000.0f - table, -400.0f) };
+        const size_t perSpawn = 300;
+        const vector<int> numPoints(perSpawn, 10);
+        ParticleSystem system;
+        Rng rng(18);
+        for (const Vector2f& center : centers) {
+            system.spawn(center, numPoints.data(), perSpawn, rng);
+            system.spawn(center + Vector2f(120.0f, 0.0f), numPoints.data(), perSpawn, rng);
+        }
+        // A few steps spread each crowd out from its center
+        for (int step = 0; step < 5; ++step) {
+            system.update(0.02f);
+        }
+
+        const size_t n = system.size();
+        vector<ParticleSystem::State> before(n);
+        for (size_t k = 0; k < n; ++k) {
+            before[k] = system.state(k);
+        }
+
+        // The narrow phase of collide, in float like it, over all n^2 pairs
+        vector<float> dvx(n, 0.0f);
+        vector<float> dvy(n, 0.0f);
+        size_t contacts = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const float ax = (float)before[i].x, ay = (float)before[i].y;
+            const float avx = (float)before[i].vx, avy = (float)before[i].vy;
+            const float ar = (float)(ParticleSystem::MAX_RADIUS * before[i].scale);
+            for (size_t j = 0; j < n; ++j) {
+                const float dx = ax - (float)before[j].x;
+                const float dy = ay - (float)before[j].y;
+                const float reach = ar + (float)(ParticleSystem::MAX_RADIUS * before[j].scale);
+                const float d2 = dx * dx + dy * dy;
+                if (d2 >= reach * reach || d2 < 1e-6f) {
+                    continue;
+                }
+                const float d = sqrt(d2);
+                const float nx = dx / d;
+                const float ny = dy / d;
+                const float closing = (avx - (float)before[j].vx) * nx + (avy - (float)before[j].vy) * ny;
+                if (closing < 0.0f) {
+                    dvx[i] -= closing * nx;
+                    dvy[i] -= closing * ny;
+                    ++contacts;
+                }
+            }
+        }
+
+        ThreadPool pool(4);
+        system.setCollisions(true);
+        system.collide(pool);
+
+        bool ok = contacts > 0;
+        if (!ok) {
+            fprintf(stderr, "MicroBench: self-check failed: the collision check set up no contacts\n");
+        }
+        for (size_t k = 0; k < n && ok; ++k) {
+            const ParticleSystem::State after = system.state(k);
+            const double wantVx = before[k].vx + dvx[k];
+            const double wantVy = before[k].vy + dvy[k];
+            // Contacts are summed in grid order there and index order here
+            const double tolerance = 1e-3 * (1.0 + fabs(wantVx) + fabs(wantVy));
+            if (fabs(after.vx - wantVx) > tolerance || fabs(after.vy - wantVy) > tolerance) {
+                fprintf(stderr, "MicroBench: self-check failed: collide gave particle %zu at (%.1f, %.1f) "
+                        "velocity (%.3f, %.3f), brute force (%.3f, %.3f)\n", k, before[k].x, before[k].y,
+                        after.vx, after.vy, wantVx, wantVy);
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    void squareMatrixBenchmark(int n, ThreadPool& pool)
+    {
+        Matrix a(n, n);
+        Matrix b(n, n);
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                a(i, j) = (i + j) % 7 - 3.0;
+                b(i, j) = (i * j) % 5 - 2.0;
+            }
+        }
+        measure("matrix_mul_NxN", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                Matrix c = a * b;
+                doNotOptimize(c(0, 0));
+            }
+        });
+        Matrix c(n, n);
+        measure("matrix_mul_NxN_into", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                multiply(a, b, c);
+                doNotOptimize(c(0, 0));
+            }
+        });
+        measure("matrix_mul_NxN_pool", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                multiply(a, b, c, &pool);
+                doNotOptimize(c(0, 0));
+            }
+        });
+    }
+
+    void particleBenchmarks(const CartesianView& view, int n)
+    {
+        Vector2i center(view.getSize().x / 2, view.getSize().y / 2);
+
+        measure("particle_ctor", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                Particle p(view, n, center);
+                doNotOptimize(p);
+            }
+        });
+
+        Particle p(view, n, center);
+        measure("particle_update", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                p.update(1.0f / 60.0f);
+            }
+            doNotOptimize(p);
+        });
+
+        VertexArray lines(TriangleFan);
+        measure("particle_draw_vertices", n, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                p.buildVertices(lines);
+                doNotOptimize(lines[0]);
+            }
+        });
+    }
+
+    void kernelBenchmarks(int n)
+    {
+        Matrix a = randomShape(n);
+        VertexKernels::ParticleTransform t = VertexKernels::makeTransform(1.0, 2.0, 0.01, SCALE, 0.5, -0.5);
+        const VertexKernels::InstructionSet best = VertexKernels::detectInstructionSet();
+        const VertexKernels::InstructionSet all[] = { VertexKernels::InstructionSet::Scalar,
+                                                      VertexKernels::InstructionSet::SSE2,
+                                                      VertexKernels::InstructionSet::AVX2,
+                                                      VertexKernels::InstructionSet::AVX512 };
+        for (VertexKernels::InstructionSet isa : all) {
+            if (isa > best) {
+                continue;
+            }
+            VertexKernels::setInstructionSet(isa);
+            measure("vertex_kernel_transform", n, [&](size_t iters) {
+                for (size_t i = 0; i < iters; ++i) {
+                    VertexKernels::transformVertices(a.data(), a.data(), n, t);
+                }
+                doNotOptimize(a(0, 0));
+            });
+        }
+        VertexKernels::setInstructionSet(best);
+    }
+
+    void systemBenchmarks(const CartesianView& view, ThreadPool& pool, int particles)
+    {
+        ParticleSystem system;
+        Rng rng(1);
+        for (int i = 0; i < particles; ++i) {
+            system.spawn(Vector2f(rng.uniform(-400.0f, 400.0f), rng.uniform(-300.0f, 300.0f)), rng.range(25, 50), rng);
+        }
+        const int vertices = (int)system.vertexCount();
+
+        // One emitter shot of `particles` at once into reserved storage, as a
+        // high-rate emitter spawns them
+        {
+            ParticleSystem shots;
+            shots.reserve(particles);
+            vector<int> points(particles);
+            rng.fillRange(points.data(), points.size(), 25, 50);
+            measure("system_spawn_bulk", particles, [&](size_t iters) {
+                for (size_t i = 0; i < iters; ++i) {
+                    shots.clear();
+                    shots.spawn(Vector2f(0.0f, 0.0f), points.data(), points.size(), rng);
+                    doNotOptimize(shots.size());
+                }
+            });
+        }
+
+        measure("system_cull", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                system.cull(view.getBounds(), pool);
+                doNotOptimize(system.visibleCount());
+            }
+        });
+
+        Snapshot previous;
+        Snapshot current;
+        system.cull(view.getBounds(), pool);
+        system.snapshot(previous, 0, 0.0, pool);
+        system.update(1e-6f);
+        system.cull(view.getBounds(), pool);
+        measure("system_snapshot", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                system.snapshot(current, 1, 1.0, pool);
+                doNotOptimize(current.centerX[0]);
+            }
+        });
+
+        vector<Vertex> triangles;
+        measure("snapshot_build_triangles", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                buildTriangles(previous, current, 1.0f, view, triangles, pool);
+                doNotOptimize(triangles[0]);
+            }
+        });
+        measure("snapshot_interpolate_triangles", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                buildTriangles(previous, current, 0.5f, view, triangles, pool);
+                doNotOptimize(triangles[0]);
+            }
+        });
+
+        // The governor's coarsest detail level
+        vector<uint32_t> triangleStart;
+        measure("snapshot_build_triangles_lod", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                buildTriangles(previous, current, 0.5f, view, triangles, pool, 32.0f, triangleStart);
+                doNotOptimize(triangles[0]);
+            }
+        });
+
+        // The CPU backend drawing a full-detail frame of them, clear included
+        buildTriangles(previous, current, 1.0f, view, triangles, pool);
+        SoftwareRasterizer raster(pool, view.getSize());
+        measure("raster_triangles", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                raster.clear(Color::Black);
+                raster.drawTriangles(triangles.data(), triangles.size());
+                doNotOptimize(raster.getPixels()[0]);
+            }
+        });
+
+        // Last: millions of steps leave every particle fallen out of view
+        measure("system_update", vertices, [&](size_t iters) {
+            for (size_t i = 0; i < iters; ++i) {
+                system.update(1e-6f);
+            }
+        });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--min-time") == 0) g_minTime = atof(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0) g_filter = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0) {
+            g_out = fopen(argv[++i], "w");
+            if (g_out == nullptr) {
+                perror("MicroBench: --out");
+                return 1;
+            }
+        }
+    }
+
+    // Nothing is timed unless every self-check passes
+    bool checked = checkVertexKernels<double>("double");
+    checked = checkVertexKernels<float>("float") && checked;
+    checked = checkMultiply() && checked;
+    checked = checkGrid() && checked;
+    checked = checkCollisions() && checked;
+    if (!checked) {
+        return 1;
+    }
+
+    fprintf(g_out, "benchmark,size,isa,iterations,ns_per_op,ns_per_vertex\n");
+
+    // Cost of one PROFILE_SCOPE, drained every 1024 scopes as a frame would be
+    Profiler::beginFrame();
+    measure("profile_scope", 1, [](size_t iters) {
+        for (size_t i = 0; i < iters; ++i) {
+            PROFILE_SCOPE("bench");
+            if ((i & 1023) == 1023) {
+                Profiler::endFrame();
+                Profiler::beginFrame();
+            }
+        }
+    });
+    Profiler::endFrame();
+
+    // Nothing drains the profiler from here on; keep its timers out of the numbers
+    Profiler::setEnabled(false);
+
+    measure("rotation_matrix_ctor", 2, [](size_t iters) {
+        for (size_t i = 0; i < iters; ++i) {
+            RotationMatrix r(0.001 * (double)i);
+            doNotOptimize(r(0, 0));
+        }
+    });
+    measure("scaling_matrix_ctor", 2, [](size_t iters) {
+        for (size_t i = 0; i < iters; ++i) {
+            ScalingMatrix s(0.999);
+            doNotOptimize(s(0, 0));
+        }
+    });
+
+    // Shape sizes the engine spawns (25-50) plus larger synthetic ones
+    const int shapeSizes[] = { 25, 37, 50, 256, 1024, 4096 };
+    CartesianView view(Vector2u(1920, 1080));
+    for (int n : shapeSizes) {
+        matrixBenchmarks(n);
+        particleBenchmarks(view, n);
+        kernelBenchmarks(n);
+    }
+    // 51 leaves the longest tail on every kernel (3 vertices past a multiple
+    // of 4 and of 8); a slow tail shows up here against the scalar row
+    kernelBenchmarks(51);
+
+    // The pooled products use every core; the system benchmarks stay on one
+    ThreadPool matrixPool;
+    const int squareSizes[] = { 16, 64, 256, 512 };
+    for (int n : squareSizes) {
+        squareMatrixBenchmark(n, matrixPool);
+    }
+
+    ThreadPool pool(1);
+    const int systemSizes[] = { 1000, 10000, 100000 };
+    for (int particles : systemSizes) {
+        systemBenchmarks(view, pool, particles);
+    }
+
+    if (g_out != stdout) {
+        fclose(g_out);
+    }
+    return 0;
+}
@@ -1,11 +1,125 @@
 #include "Engine.h"
+#include "Benchmark.h"
+#include <cstdlib>
+#include <cstring>
 
-int main()
+int main(int argc, char* argv[])
 {
+	// Optional: --threads N sets the number of simulation threads
+	// (default: one per core, --threads 1 runs the simulation single-threaded)
+	// Optional: --render-threads N sets the threads that build each frame (default: one per core)
+	// Optional: --seed N reproduces an earlier run (default: seeded from the clock)
+	// Optional: --collisions starts with particle-particle collisions on (F4 toggles them)
+	// Optional: --record FILE logs every tick's input to FILE for a later --replay
+	// Optional: --replay FILE plays FILE back instead of taking clicks; with
+	// --headless it runs as fast as it can and checks the final state (exit code 1 on a mismatch)
+	// Optional: --restore FILE starts from the particles saved in a checkpoint (F7 saves one);
+	// a log recorded after a restore replays with the same --restore
+	// Optional: --frame-budget MS is the frame time to hold by lowering detail and then
+	// turning spawns away (default 16.7, 0 turns that off)
+	// Optional: --max-particles N never lets more than N particles live (default: no limit)
+	// Optional: --software draws on the CPU instead of through OpenGL (F8 toggles it, F9 saves frame.png);
+	// --headless --raster times the CPU rasterizer and --frame-out FILE saves the last frame
+	unsigned threadCount = 0;
+	unsigned renderThreadCount = 0;
+	uint64_t seed = 0;
+	bool collisions = false;
+	bool headless = false;
+	bool software = false;
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+	const char* restorePath = nullptr;
+	double frameBudgetMs = -1.0;
+	size_t maxParticles = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--collisions") == 0)
+		{
+			collisions = true;
+		}
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		if (strcmp(argv[i], "--software") == 0)
+		{
+			software = true;
+		}
+		if (i + 1 == argc)
+		{
+			break;
+		}
+		if (strcmp(argv[i], "--record") == 0)
+		{
+			recordPath = argv[i + 1];
+		}
+		if (strcmp(argv[i], "--replay") == 0)
+		{
+			replayPath = argv[i + 1];
+		}
+		if (strcmp(argv[i], "--restore") == 0)
+		{
+			restorePath = argv[i + 1];
+		}
+		if (strcmp(argv[i], "--frame-budget") == 0)
+		{
+			frameBudgetMs = atof(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "--max-particles") == 0)
+		{
+			maxParticles = (size_t)strtoull(argv[i + 1], nullptr, 10);
+		}
+		if (strcmp(argv[i], "--threads") == 0)
+		{
+			threadCount = (unsigned)atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "--render-threads") == 0)
+		{
+			renderThreadCount = (unsigned)atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "--seed") == 0)
+		{
+			seed = strtoull(argv[i + 1], nullptr, 10);
+		}
+	}
+
+	if (headless && replayPath != nullptr)
+	{
+		return InputLog::replayHeadless(replayPath, threadCount, restorePath ? restorePath : "") ? 0 : 1;
+	}
+
+	// --headless runs the scripted benchmark without opening a window
+	BenchmarkConfig benchmarkConfig;
+	if (Benchmark::parseArgs(argc, argv, benchmarkConfig))
+	{
+		Benchmark benchmark(benchmarkConfig);
+		benchmark.run();
+		return 0;
+	}
+
 	// Declare an instance of Engine
-	Engine engine;
+	Engine engine(threadCount, seed, renderThreadCount);
+	engine.setCollisions(collisions);
+	engine.setSoftwareRendering(software);
+	if (frameBudgetMs >= 0.0)
+	{
+		engine.setFrameBudget(frameBudgetMs);
+	}
+	engine.setMaxParticles(maxParticles);
+	if (restorePath != nullptr && !engine.loadCheckpoint(restorePath))
+	{
+		return 1;
+	}
+	if (replayPath != nullptr && !engine.startReplay(replayPath))
+	{
+		return 1;
+	}
+	if (recordPath != nullptr && replayPath == nullptr && !engine.startRecording(recordPath))
+	{
+		return 1;
+	}
 	// Start the engine
 	engine.run();
 	// Quit in the usual way when the engine is stopped
 	return 0;
-}
\ No newline at end of file
+}